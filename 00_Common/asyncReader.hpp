@@ -0,0 +1,476 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// io_uring se usa con llamadas al sistema directas, sin liburing
+#if defined(__linux__) && defined(__NR_io_uring_setup) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define BDW_HAVE_IO_URING 1
+// linux/fs.h (incluido por io_uring.h) define macros que chocan con constantes
+// como Arena::BLOCK_SIZE
+#undef BLOCK_SIZE
+#undef BLOCK_SIZE_BITS
+#endif
+
+// Alineacion de buffers, offsets y longitudes que exige O_DIRECT
+constexpr size_t IO_ALIGNMENT = 4096;
+
+struct AlignedFree {
+    void operator()(char* p) const { std::free(p); }
+};
+
+using AlignedBuffer = std::unique_ptr<char, AlignedFree>;
+
+inline size_t align_up(size_t value, size_t alignment = IO_ALIGNMENT) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+inline AlignedBuffer make_aligned_buffer(size_t size) {
+    void* p = std::aligned_alloc(IO_ALIGNMENT, align_up(std::max<size_t>(size, 1)));
+    if (!p) throw std::bad_alloc();
+    return AlignedBuffer(static_cast<char*>(p));
+}
+
+// pread que reintenta hasta leer len bytes o llegar al final del archivo
+inline ssize_t pread_full(int fd, char* buffer, size_t len, uint64_t offset) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = ::pread(fd, buffer + done, len - done, static_cast<off_t>(offset + done));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -errno;
+        }
+        if (n == 0) break;
+        done += static_cast<size_t>(n);
+    }
+    return static_cast<ssize_t>(done);
+}
+
+// Motor de lecturas asincronas. submit encola una lectura identificada por tag y
+// wait devuelve los bytes leidos (o -errno) cuando esa lectura termina. Lo usa un
+// solo hilo lector; los tags en vuelo deben ser distintos.
+class IoEngine {
+public:
+    virtual ~IoEngine() {}
+    virtual void submit(size_t tag, int fd, char* buffer, size_t len, uint64_t offset) = 0;
+    virtual ssize_t wait(size_t tag) = 0;
+    virtual const char* name() const = 0;
+};
+
+// Respaldo portable: un grupo de hilos que hace pread
+class ThreadPoolEngine : public IoEngine {
+private:
+    struct Request {
+        size_t tag;
+        int fd;
+        char* buffer;
+        size_t len;
+        uint64_t offset;
+    };
+
+    std::vector<std::thread> threads;
+    std::deque<Request> requests;
+    std::unordered_map<size_t, ssize_t> results;
+    std::mutex mutex;
+    std::condition_variable request_cv;
+    std::condition_variable result_cv;
+    bool stopping = false;
+
+    void run() {
+        while (true) {
+            Request request;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                request_cv.wait(lock, [this] { return !requests.empty() || stopping; });
+                if (requests.empty()) return;
+                request = requests.front();
+                requests.pop_front();
+            }
+            ssize_t n = pread_full(request.fd, request.buffer, request.len, request.offset);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                results[request.tag] = n;
+            }
+            result_cv.notify_all();
+        }
+    }
+
+public:
+    explicit ThreadPoolEngine(size_t num_threads) {
+        for (size_t i = 0; i < std::max<size_t>(1, num_threads); ++i) {
+            threads.emplace_back([this] { run(); });
+        }
+    }
+
+    ~ThreadPoolEngine() override {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        request_cv.notify_all();
+        for (auto& thread : threads) thread.join();
+    }
+
+    void submit(size_t tag, int fd, char* buffer, size_t len, uint64_t offset) override {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            requests.push_back({tag, fd, buffer, len, offset});
+        }
+        request_cv.notify_one();
+    }
+
+    ssize_t wait(size_t tag) override {
+        std::unique_lock<std::mutex> lock(mutex);
+        result_cv.wait(lock, [&] { return results.count(tag) > 0; });
+        ssize_t n = results[tag];
+        results.erase(tag);
+        return n;
+    }
+
+    const char* name() const override {
+        return "threads (pread)";
+    }
+};
+
+#ifdef BDW_HAVE_IO_URING
+// io_uring con un anillo propio: IORING_OP_READ por cada lectura y
+// io_uring_enter para enviar y esperar completados
+class IoUringEngine : public IoEngine {
+private:
+    int ring_fd = -1;
+    void* sq_ptr = MAP_FAILED;
+    void* cq_ptr = MAP_FAILED;
+    size_t sq_size = 0;
+    size_t cq_size = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqes_size = 0;
+
+    unsigned* sq_tail = nullptr;
+    unsigned* sq_mask = nullptr;
+    unsigned* sq_array = nullptr;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned* cq_mask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+
+    std::unordered_map<size_t, ssize_t> results;
+
+    static unsigned* field(void* base, uint32_t offset) {
+        return reinterpret_cast<unsigned*>(static_cast<char*>(base) + offset);
+    }
+
+    int enter(unsigned to_submit, unsigned min_complete, unsigned flags) {
+        while (true) {
+            int ret = static_cast<int>(::syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0));
+            if (ret >= 0 || errno != EINTR) return ret;
+        }
+    }
+
+    void release() {
+        if (sqes != MAP_FAILED) ::munmap(sqes, sqes_size);
+        if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) ::munmap(cq_ptr, cq_size);
+        if (sq_ptr != MAP_FAILED) ::munmap(sq_ptr, sq_size);
+        if (ring_fd >= 0) ::close(ring_fd);
+    }
+
+public:
+    explicit IoUringEngine(unsigned entries) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        ring_fd = static_cast<int>(::syscall(__NR_io_uring_setup, std::max(entries, 1u), &params));
+        if (ring_fd < 0) {
+            throw std::runtime_error(std::string("io_uring_setup failed: ") + std::strerror(errno));
+        }
+
+        sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap) sq_size = cq_size = std::max(sq_size, cq_size);
+
+        sq_ptr = ::mmap(nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+        cq_ptr = single_mmap ? sq_ptr
+                             : ::mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(::mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+                                                 MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES));
+        if (sq_ptr == MAP_FAILED || cq_ptr == MAP_FAILED || sqes == MAP_FAILED) {
+            release();
+            throw std::runtime_error("Failed to map io_uring rings");
+        }
+
+        sq_tail = field(sq_ptr, params.sq_off.tail);
+        sq_mask = field(sq_ptr, params.sq_off.ring_mask);
+        sq_array = field(sq_ptr, params.sq_off.array);
+        cq_head = field(cq_ptr, params.cq_off.head);
+        cq_tail = field(cq_ptr, params.cq_off.tail);
+        cq_mask = field(cq_ptr, params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(static_cast<char*>(cq_ptr) + params.cq_off.cqes);
+    }
+
+    ~IoUringEngine() override {
+        release();
+    }
+
+    void submit(size_t tag, int fd, char* buffer, size_t len, uint64_t offset) override {
+        unsigned tail = *sq_tail;
+        unsigned index = tail & *sq_mask;
+        io_uring_sqe* sqe = &sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(buffer);
+        sqe->len = static_cast<uint32_t>(len);
+        sqe->off = offset;
+        sqe->user_data = tag;
+        sq_array[index] = index;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+        if (enter(1, 0, 0) < 0) {
+            throw std::runtime_error(std::string("io_uring_enter failed: ") + std::strerror(errno));
+        }
+    }
+
+    ssize_t wait(size_t tag) override {
+        while (true) {
+            auto it = results.find(tag);
+            if (it != results.end()) {
+                ssize_t n = it->second;
+                results.erase(it);
+                return n;
+            }
+
+            unsigned head = *cq_head;
+            if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+                if (enter(0, 1, IORING_ENTER_GETEVENTS) < 0) {
+                    throw std::runtime_error(std::string("io_uring_enter failed: ") + std::strerror(errno));
+                }
+                continue;
+            }
+            const io_uring_cqe& cqe = cqes[head & *cq_mask];
+            results[static_cast<size_t>(cqe.user_data)] = cqe.res;
+            __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+        }
+    }
+
+    const char* name() const override {
+        return "io_uring";
+    }
+};
+#endif
+
+// Crea el motor pedido: "uring", "threads" o "" / "auto" (io_uring si el kernel
+// lo permite, si no hilos con pread)
+inline std::unique_ptr<IoEngine> make_io_engine(const std::string& mode, size_t depth) {
+    if (mode != "" && mode != "auto" && mode != "uring" && mode != "threads") {
+        throw std::invalid_argument("Unknown async I/O mode: " + mode);
+    }
+#ifdef BDW_HAVE_IO_URING
+    if (mode != "threads") {
+        try {
+            return std::make_unique<IoUringEngine>(static_cast<unsigned>(depth));
+        } catch (const std::exception&) {
+            if (mode == "uring") throw;
+        }
+    }
+#else
+    if (mode == "uring") throw std::runtime_error("io_uring is not available in this build");
+#endif
+    return std::make_unique<ThreadPoolEngine>(depth);
+}
+
+// Chunk leido de forma asincrona. El texto vive en un buffer alineado propio que
+// pasa a los hilos sin copiarse.
+struct ReadBlock {
+    AlignedBuffer buffer;
+    size_t begin = 0;
+    size_t end = 0;
+    uint64_t file_offset = 0;  // Posicion del primer byte del texto en el archivo
+
+    std::string_view text() const {
+        return std::string_view(buffer.get() + begin, end - begin);
+    }
+
+    size_t size() const {
+        return end - begin;
+    }
+};
+
+// Lee un archivo en bloques de chunk_size con depth lecturas en vuelo (doble
+// buffer con depth = 2) y entrega chunks que terminan en un espacio en blanco.
+// Cada buffer reserva HEADROOM bytes delante de los datos: la palabra cortada al
+// final del bloque anterior se copia ahi, asi el chunk queda contiguo sin copiar
+// el bloque. Con direct el archivo se abre con O_DIRECT y no pasa por la cache de
+// paginas (si el sistema de archivos no lo admite se lee normal).
+class AsyncFileReader {
+private:
+    static constexpr size_t HEADROOM = 64 * 1024;
+
+    struct Slot {
+        AlignedBuffer buffer;
+        uint64_t offset = 0;
+        bool in_flight = false;
+    };
+
+    IoEngine& engine;
+    int fd = -1;
+    uint64_t length = 0;
+    size_t block_size;
+    bool direct = false;
+    std::string path;
+    std::vector<Slot> slots;
+    size_t next_slot = 0;        // Proximo slot a entregar (en orden de archivo)
+    uint64_t next_offset = 0;    // Proximo offset a pedir
+    std::string leftover;        // Palabra cortada al final del bloque anterior
+    uint64_t leftover_offset = 0;
+
+    void start(Slot& slot) {
+        if (next_offset >= length) return;
+        slot.offset = next_offset;
+        next_offset += block_size;
+        if (!slot.buffer) slot.buffer = make_aligned_buffer(HEADROOM + block_size);
+        engine.submit(static_cast<size_t>(&slot - slots.data()), fd, slot.buffer.get() + HEADROOM, block_size, slot.offset);
+        slot.in_flight = true;
+    }
+
+    // Espera la lectura del slot; completa lecturas cortas antes del final del archivo
+    size_t finish(Slot& slot) {
+        size_t tag = static_cast<size_t>(&slot - slots.data());
+        ssize_t n = engine.wait(tag);
+        slot.in_flight = false;
+        size_t expected = static_cast<size_t>(std::min<uint64_t>(block_size, length - slot.offset));
+        size_t done = n > 0 ? static_cast<size_t>(n) : 0;
+        while (n > 0 && done < expected) {
+            ssize_t more = pread_full(fd, slot.buffer.get() + HEADROOM + done, expected - done, slot.offset + done);
+            if (more <= 0) { n = more; break; }
+            done += static_cast<size_t>(more);
+        }
+        if (n < 0) {
+            throw std::runtime_error("Failed to read file: " + path + ": " + std::strerror(static_cast<int>(-n)));
+        }
+        return done;
+    }
+
+public:
+    AsyncFileReader(IoEngine& io_engine, const std::string& file_path, size_t chunk_size,
+                    size_t depth, bool use_direct)
+        : engine(io_engine), block_size(align_up(std::max<size_t>(chunk_size, 1))), path(file_path) {
+        if (use_direct) {
+            fd = ::open(path.c_str(), O_RDONLY | O_DIRECT);
+            direct = fd >= 0;
+        }
+        if (fd < 0) fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open input file: " + path);
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Failed to stat file: " + path);
+        }
+        length = static_cast<uint64_t>(st.st_size);
+        if (!direct) ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+        slots.resize(std::max<size_t>(1, depth));
+        for (auto& slot : slots) start(slot);
+    }
+
+    ~AsyncFileReader() {
+        // Los buffers no se pueden liberar con lecturas en vuelo
+        for (size_t i = 0; i < slots.size(); ++i) {
+            if (slots[i].in_flight) engine.wait(i);
+        }
+        ::close(fd);
+    }
+
+    AsyncFileReader(const AsyncFileReader&) = delete;
+    AsyncFileReader& operator=(const AsyncFileReader&) = delete;
+
+    bool is_direct() const {
+        return direct;
+    }
+
+    // Siguiente chunk del archivo; false al terminar
+    bool next(ReadBlock& out) {
+        while (true) {
+            Slot& slot = slots[next_slot];
+            if (!slot.in_flight) {
+                // Fin del archivo: queda como mucho la ultima palabra
+                if (leftover.empty()) return false;
+                out.buffer = make_aligned_buffer(leftover.size());
+                std::memcpy(out.buffer.get(), leftover.data(), leftover.size());
+                out.begin = 0;
+                out.end = leftover.size();
+                out.file_offset = leftover_offset;
+                leftover.clear();
+                return true;
+            }
+
+            size_t n = finish(slot);
+            bool last = slot.offset + n >= length;
+
+            // El buffer pasa al chunk; el slot recibe uno nuevo para la siguiente lectura
+            AlignedBuffer buffer = std::move(slot.buffer);
+            uint64_t offset = slot.offset;
+            next_slot = (next_slot + 1) % slots.size();
+            start(slot);
+
+            size_t begin = HEADROOM;
+            size_t end = HEADROOM + n;
+            uint64_t text_offset = offset;
+            if (!leftover.empty()) {
+                if (leftover.size() > HEADROOM) {
+                    // Palabra enorme: se copia todo a un buffer nuevo
+                    AlignedBuffer joined = make_aligned_buffer(leftover.size() + n);
+                    std::memcpy(joined.get(), leftover.data(), leftover.size());
+                    std::memcpy(joined.get() + leftover.size(), buffer.get() + HEADROOM, n);
+                    buffer = std::move(joined);
+                    begin = 0;
+                    end = leftover.size() + n;
+                } else {
+                    begin = HEADROOM - leftover.size();
+                    std::memcpy(buffer.get() + begin, leftover.data(), leftover.size());
+                }
+                text_offset = leftover_offset;
+                leftover.clear();
+            }
+
+            if (!last) {
+                // Cortar despues del ultimo espacio; el resto pasa al siguiente chunk
+                size_t cut = end;
+                while (cut > begin && !std::isspace(static_cast<unsigned char>(buffer.get()[cut - 1]))) --cut;
+                size_t tail = cut > begin ? cut : begin;
+                leftover.assign(buffer.get() + tail, end - tail);
+                leftover_offset = text_offset + (tail - begin);
+                end = tail;
+                if (end == begin) continue;  // Sin espacios: todo el bloque es parte de una palabra
+            }
+
+            out.buffer = std::move(buffer);
+            out.begin = begin;
+            out.end = end;
+            out.file_offset = text_offset;
+            return true;
+        }
+    }
+};
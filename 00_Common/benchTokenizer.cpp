@@ -0,0 +1,127 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <cstdint>
+
+#include "tokenizer.hpp"
+
+using namespace std;
+
+// Compara el bucle original de process_chunk (istringstream + substr + transform)
+// con Tokenizer sobre el mismo texto, con cada kernel disponible en la CPU. Todos
+// calculan un hash de la secuencia de tokens, de modo que ademas de la velocidad
+// se comprueba que producen exactamente lo mismo. El hash completo se calcula en
+// una pasada aparte sin cronometrar para que no domine la medicion.
+
+struct Result {
+    bool full_hash = false;
+    uint64_t tokens = 0;
+    uint64_t hash = 1469598103934665603ULL;
+    double seconds = 0;
+
+    void add(string_view token) {
+        tokens++;
+        if (!full_hash) {
+            hash = hash * 31 + token.size() + static_cast<unsigned char>(token.back());
+            return;
+        }
+        for (unsigned char c : token) {
+            hash = (hash ^ c) * 1099511628211ULL;
+        }
+        hash = (hash ^ 0xFF) * 1099511628211ULL; // separador entre tokens
+    }
+};
+
+Result run_legacy(const string& text, bool full_hash) {
+    Result result;
+    result.full_hash = full_hash;
+    auto start = chrono::high_resolution_clock::now();
+    istringstream stream(text);
+    string word;
+    while (stream >> word) {
+        size_t start = 0, end = word.size();
+        while (start < end && ispunct(static_cast<unsigned char>(word[start]))) ++start;
+        while (end > start && ispunct(static_cast<unsigned char>(word[end - 1]))) --end;
+        if (start < end) {
+            string clean_word = word.substr(start, end - start);
+            transform(clean_word.begin(), clean_word.end(), clean_word.begin(), ::tolower);
+            result.add(clean_word);
+        }
+    }
+    result.seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+    return result;
+}
+
+Result run_tokenizer(const string& text, TokenizerKernel kernel, bool full_hash,
+                     unsigned normalize = NORMALIZE_NONE) {
+    Result result;
+    result.full_hash = full_hash;
+    Tokenizer tokenizer(normalize, kernel);
+    auto start = chrono::high_resolution_clock::now();
+    tokenizer.tokenize(text, [&](string_view word) { result.add(word); });
+    result.seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+    return result;
+}
+
+void report(const string& name, const Result& result, size_t bytes) {
+    cout << left << setw(20) << name << right
+         << setw(12) << result.tokens << " tokens  "
+         << fixed << setprecision(3) << setw(8) << result.seconds << " s  "
+         << setprecision(1) << setw(8) << bytes / (1024.0 * 1024.0) / result.seconds << " MB/s" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <input_file> [repeat]" << endl;
+        return 1;
+    }
+
+    ifstream file(argv[1], ios::binary);
+    if (!file.is_open()) {
+        cerr << "Failed to open input file: " << argv[1] << endl;
+        return 1;
+    }
+    string content((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+
+    // Repetir el contenido permite medir con archivos pequenos como los de 00_Inputs
+    size_t repeat = (argc > 2) ? stoul(argv[2]) : 1;
+    string text;
+    text.reserve(content.size() * repeat + repeat);
+    for (size_t i = 0; i < repeat; ++i) {
+        text += content;
+        text += '\n';
+    }
+
+    cout << "Input: " << argv[1] << " x" << repeat << " (" << text.size() << " bytes)" << endl;
+    Result legacy = run_legacy(text, false);
+    report("legacy", legacy, text.size());
+    Result expected = run_legacy(text, true);
+
+    bool mismatch = false;
+    for (TokenizerKernel kernel : {TokenizerKernel::Scalar, TokenizerKernel::SSE2, TokenizerKernel::AVX2}) {
+        if (!kernel_supported(kernel)) {
+            cout << kernel_name(kernel) << ": not supported on this CPU" << endl;
+            continue;
+        }
+        Result fast = run_tokenizer(text, kernel, false);
+        report(kernel_name(kernel), fast, text.size());
+        Result checked = run_tokenizer(text, kernel, true);
+        if (expected.tokens != checked.tokens || expected.hash != checked.hash) {
+            cerr << "Token mismatch between legacy loop and " << kernel_name(kernel) << " kernel" << endl;
+            mismatch = true;
+        }
+    }
+    cout << "Default kernel: " << kernel_name(best_kernel()) << endl;
+
+    // Coste de la normalizacion UTF-8 (no se compara con el bucle original)
+    for (unsigned mode : {unsigned(NORMALIZE_DEFAULT), unsigned(NORMALIZE_ALL)}) {
+        Result normalized = run_tokenizer(text, best_kernel(), false, mode);
+        report(normalize_mode_name(mode), normalized, text.size());
+    }
+    return mismatch ? 1 : 0;
+}
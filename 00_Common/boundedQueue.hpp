@@ -0,0 +1,89 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Cola MPMC acotada sobre un buffer circular. Los elementos se mueven al entrar
+// y al salir (T puede ser solo movible). push bloquea mientras la cola esta llena
+// (backpressure para el lector) y pop mientras esta vacia; close() despierta a
+// todos: push devuelve false y pop vacia lo que queda antes de devolver false.
+//
+// La seccion critica es solo el movimiento del elemento y los indices, y solo se
+// notifica cuando hay hilos esperando, asi que con colas cortas la contencion es baja.
+template <typename T>
+class BoundedQueue {
+private:
+    std::vector<T> slots;
+    size_t head = 0;   // Proxima posicion a leer
+    size_t count = 0;  // Elementos en la cola
+    bool closed = false;
+    size_t waiting_producers = 0;
+    size_t waiting_consumers = 0;
+    std::mutex mutex;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+
+public:
+    explicit BoundedQueue(size_t capacity) : slots(capacity > 0 ? capacity : 1) {}
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    bool push(T&& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (count == slots.size() && !closed) {
+            waiting_producers++;
+            not_full.wait(lock, [this] { return count < slots.size() || closed; });
+            waiting_producers--;
+        }
+        if (closed) return false;
+
+        slots[(head + count) % slots.size()] = std::move(item);
+        count++;
+        bool wake = waiting_consumers > 0;
+        lock.unlock();
+        if (wake) not_empty.notify_one();
+        return true;
+    }
+
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (count == 0 && !closed) {
+            waiting_consumers++;
+            not_empty.wait(lock, [this] { return count > 0 || closed; });
+            waiting_consumers--;
+        }
+        if (count == 0) return false;
+
+        item = std::move(slots[head]);
+        slots[head] = T();
+        head = (head + 1) % slots.size();
+        count--;
+        bool wake = waiting_producers > 0;
+        lock.unlock();
+        if (wake) not_full.notify_one();
+        return true;
+    }
+
+    // Ya no se aceptan elementos; los consumidores terminan al vaciar la cola
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        not_full.notify_all();
+        not_empty.notify_all();
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return count;
+    }
+
+    size_t capacity() const {
+        return slots.size();
+    }
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// Escribe en un buffer propio de 1 MB y vuelca con write(); sin iostreams ni
+// locale. Los enteros se formatean a mano de dos en dos digitos.
+class BufferedWriter {
+private:
+    static constexpr size_t BUFFER_SIZE = 1 << 20;
+
+    int fd = -1;
+    std::string path;
+    std::unique_ptr<char[]> buffer;
+    size_t used = 0;
+
+    void write_all(const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t n = ::write(fd, data, size);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error("Failed to write file: " + path);
+            }
+            data += n;
+            size -= static_cast<size_t>(n);
+        }
+    }
+
+public:
+    explicit BufferedWriter(const std::string& file_path, bool append = false)
+        : path(file_path), buffer(new char[BUFFER_SIZE]) {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC), 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open output file: " + path);
+        }
+    }
+
+    // close() informa de los errores; el destructor solo vuelca lo que quede
+    ~BufferedWriter() {
+        if (fd < 0) return;
+        try {
+            flush();
+        } catch (...) {
+        }
+        ::close(fd);
+    }
+
+    BufferedWriter(const BufferedWriter&) = delete;
+    BufferedWriter& operator=(const BufferedWriter&) = delete;
+
+    // Escribe value en decimal terminando en end; devuelve el primer digito
+    static char* format_uint(uint64_t value, char* end) {
+        static const char digits[] =
+            "0001020304050607080910111213141516171819"
+            "2021222324252627282930313233343536373839"
+            "4041424344454647484950515253545556575859"
+            "6061626364656667686970717273747576777879"
+            "8081828384858687888990919293949596979899";
+        char* p = end;
+        while (value >= 100) {
+            size_t pair = static_cast<size_t>(value % 100) * 2;
+            value /= 100;
+            *--p = digits[pair + 1];
+            *--p = digits[pair];
+        }
+        if (value >= 10) {
+            size_t pair = static_cast<size_t>(value) * 2;
+            *--p = digits[pair + 1];
+            *--p = digits[pair];
+        } else {
+            *--p = static_cast<char>('0' + value);
+        }
+        return p;
+    }
+
+    void write(std::string_view text) {
+        if (used + text.size() > BUFFER_SIZE) {
+            flush();
+            // Un texto mayor que el buffer se escribe directamente
+            if (text.size() > BUFFER_SIZE) {
+                write_all(text.data(), text.size());
+                return;
+            }
+        }
+        std::memcpy(buffer.get() + used, text.data(), text.size());
+        used += text.size();
+    }
+
+    void put(char c) {
+        if (used == BUFFER_SIZE) flush();
+        buffer[used++] = c;
+    }
+
+    void write_uint(uint64_t value) {
+        char digits[20];
+        char* begin = format_uint(value, digits + sizeof(digits));
+        write(std::string_view(begin, static_cast<size_t>(digits + sizeof(digits) - begin)));
+    }
+
+    void flush() {
+        if (used == 0) return;
+        size_t size = used;
+        used = 0;
+        write_all(buffer.get(), size);
+    }
+
+    void close() {
+        if (fd < 0) return;
+        flush();
+        int result = ::close(fd);
+        fd = -1;
+        if (result != 0) {
+            throw std::runtime_error("Failed to close file: " + path);
+        }
+    }
+};
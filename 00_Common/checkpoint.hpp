@@ -0,0 +1,209 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// ---------------------------------------------------------------------------
+// Checkpoints de los trabajos largos (--checkpoint-interval y --resume). Un
+// checkpoint es un archivo de texto con una clave por linea y sus campos
+// separados por tabuladores:
+//
+//   BDWCHECKPOINT  1
+//   clave          campo  campo ...
+//
+// Que claves hay y que significan lo decide cada programa. Una clave puede
+// repetirse (una linea por run, por ejemplo) y el ultimo campo puede contener
+// tabuladores, asi que las rutas van siempre al final. El archivo se escribe
+// entero en un temporal que se renombra encima del anterior: tras un corte
+// siempre queda el ultimo checkpoint completo.
+// ---------------------------------------------------------------------------
+
+// Fuerza a disco un archivo ya escrito. Lo que registra un checkpoint (runs,
+// archivo temporal) tiene que estar en disco antes que el propio checkpoint
+// para que sobreviva tambien a un corte de la maquina, no solo del proceso.
+inline void sync_file(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Failed to open file for sync: " + path);
+    int result = ::fsync(fd);
+    ::close(fd);
+    if (result != 0) throw std::runtime_error("Failed to sync file: " + path);
+}
+
+class CheckpointFile {
+private:
+    // Clave y resto de la linea, en el orden del archivo
+    std::vector<std::pair<std::string, std::string>> lines;
+
+    static std::vector<std::string> split_fields(const std::string& text, size_t count) {
+        std::vector<std::string> fields;
+        size_t start = 0;
+        while (fields.size() + 1 < count) {
+            size_t tab = text.find('\t', start);
+            if (tab == std::string::npos) break;
+            fields.push_back(text.substr(start, tab - start));
+            start = tab + 1;
+        }
+        fields.push_back(text.substr(start));
+        return fields;
+    }
+
+    static std::string join_fields(const std::vector<std::string>& fields) {
+        std::string text;
+        for (size_t i = 0; i < fields.size(); ++i) {
+            if (i > 0) text += '\t';
+            text += fields[i];
+        }
+        return text;
+    }
+
+public:
+    static bool exists(const std::string& path) {
+        return std::filesystem::is_regular_file(path);
+    }
+
+    void load(const std::string& path) {
+        std::ifstream in(path);
+        std::string line;
+        if (!std::getline(in, line) || line != "BDWCHECKPOINT\t1") {
+            throw std::runtime_error("Not a checkpoint: " + path);
+        }
+        lines.clear();
+        while (std::getline(in, line)) {
+            if (line.empty()) continue;
+            size_t tab = line.find('\t');
+            if (tab == std::string::npos) {
+                lines.emplace_back(line, "");
+            } else {
+                lines.emplace_back(line.substr(0, tab), line.substr(tab + 1));
+            }
+        }
+    }
+
+    // Sustituye todas las lineas de la clave por una sola
+    void set(const std::string& key, const std::vector<std::string>& fields) {
+        remove(key);
+        add(key, fields);
+    }
+
+    void add(const std::string& key, const std::vector<std::string>& fields) {
+        lines.emplace_back(key, join_fields(fields));
+    }
+
+    void remove(const std::string& key) {
+        std::vector<std::pair<std::string, std::string>> kept;
+        for (auto& line : lines) {
+            if (line.first != key) kept.push_back(std::move(line));
+        }
+        lines.swap(kept);
+    }
+
+    bool has(const std::string& key) const {
+        for (const auto& line : lines) {
+            if (line.first == key) return true;
+        }
+        return false;
+    }
+
+    // Campos de la primera linea de la clave; los que pasen de count quedan en el ultimo
+    std::vector<std::string> get(const std::string& key, size_t count) const {
+        for (const auto& line : lines) {
+            if (line.first == key) return split_fields(line.second, count);
+        }
+        throw std::runtime_error("Checkpoint has no " + key + " entry");
+    }
+
+    std::vector<std::vector<std::string>> get_all(const std::string& key, size_t count) const {
+        std::vector<std::vector<std::string>> all;
+        for (const auto& line : lines) {
+            if (line.first == key) all.push_back(split_fields(line.second, count));
+        }
+        return all;
+    }
+
+    // true si la clave tiene los mismos campos en los dos checkpoints; sirve para
+    // comprobar que se reanuda con la misma entrada y las mismas opciones
+    bool same(const CheckpointFile& other, const std::string& key) const {
+        return has(key) && other.has(key) && get(key, SIZE_MAX) == other.get(key, SIZE_MAX);
+    }
+
+    void save(const std::string& path) const {
+        std::string temp = path + ".tmp";
+        {
+            std::ofstream out(temp, std::ios::trunc);
+            out << "BDWCHECKPOINT\t1\n";
+            for (const auto& line : lines) {
+                out << line.first << "\t" << line.second << "\n";
+            }
+            out.close();
+            if (!out) throw std::runtime_error("Failed to write checkpoint: " + temp);
+        }
+        sync_file(temp);
+        std::filesystem::rename(temp, path);
+    }
+};
+
+// Conjunto de ids terminados (chunks o documentos). Como se terminan casi en
+// orden se guarda como rangos: "0-41,43,45-50".
+class CompletedSet {
+private:
+    std::vector<bool> done;
+    size_t count = 0;
+
+public:
+    void insert(size_t id) {
+        if (id >= done.size()) done.resize(std::max(id + 1, done.size() * 2), false);
+        if (!done[id]) {
+            done[id] = true;
+            count++;
+        }
+    }
+
+    bool contains(size_t id) const {
+        return id < done.size() && done[id];
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    std::string to_string() const {
+        std::string text;
+        for (size_t id = 0; id < done.size(); ++id) {
+            if (!done[id]) continue;
+            size_t last = id;
+            while (last + 1 < done.size() && done[last + 1]) last++;
+            if (!text.empty()) text += ',';
+            text += std::to_string(id);
+            if (last > id) text += '-' + std::to_string(last);
+            id = last;
+        }
+        return text.empty() ? "-" : text;
+    }
+
+    static CompletedSet parse(const std::string& text) {
+        CompletedSet set;
+        if (text == "-") return set;
+        size_t start = 0;
+        while (start < text.size()) {
+            size_t comma = text.find(',', start);
+            if (comma == std::string::npos) comma = text.size();
+            std::string range = text.substr(start, comma - start);
+            size_t dash = range.find('-');
+            size_t first = std::stoull(range.substr(0, dash));
+            size_t last = dash == std::string::npos ? first : std::stoull(range.substr(dash + 1));
+            if (last < first) throw std::runtime_error("Corrupt checkpoint range: " + range);
+            for (size_t id = first; id <= last; ++id) set.insert(id);
+            start = comma + 1;
+        }
+        return set;
+    }
+};
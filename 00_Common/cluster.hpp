@@ -0,0 +1,341 @@
+#pragma once
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// ---------------------------------------------------------------------------
+// Sockets del modo distribuido (--coordinator y --worker). Una direccion es
+// "unix:/ruta/del/socket" para procesos de la misma maquina o "tcp:host:puerto"
+// ("host:puerto" tambien vale). Por una conexion viajan mensajes:
+//
+//   tipo (1 byte) | longitud del cuerpo (4 bytes, little endian) | cuerpo
+//
+// Que tipos hay lo decide cada programa. Los mensajes de control llevan sus
+// campos separados por '\0' (ver encode_fields) para que una ruta pueda contener
+// cualquier otro caracter.
+// ---------------------------------------------------------------------------
+
+struct SocketAddress {
+    bool is_unix = false;
+    std::string path;  // Solo unix
+    std::string host;  // Solo tcp
+    uint16_t port = 0; // Solo tcp; 0 al escuchar pide un puerto libre
+
+    static SocketAddress parse(const std::string& text) {
+        SocketAddress address;
+        if (text.compare(0, 5, "unix:") == 0) {
+            address.is_unix = true;
+            address.path = text.substr(5);
+            if (address.path.empty() || address.path.size() >= sizeof(sockaddr_un::sun_path)) {
+                throw std::runtime_error("Invalid unix socket path: " + text);
+            }
+            return address;
+        }
+        std::string rest = text.compare(0, 4, "tcp:") == 0 ? text.substr(4) : text;
+        size_t colon = rest.rfind(':');
+        if (colon == std::string::npos || colon + 1 == rest.size()) {
+            throw std::runtime_error("Invalid address (expected unix:PATH or tcp:HOST:PORT): " + text);
+        }
+        address.host = colon == 0 ? "0.0.0.0" : rest.substr(0, colon);
+        unsigned long port = std::stoul(rest.substr(colon + 1));
+        if (port > 65535) throw std::runtime_error("Invalid port: " + text);
+        address.port = static_cast<uint16_t>(port);
+        return address;
+    }
+
+    std::string to_string() const {
+        return is_unix ? "unix:" + path : "tcp:" + host + ":" + std::to_string(port);
+    }
+};
+
+// Conexion con duenio unico; se cierra al destruirse
+class Socket {
+private:
+    int fd = -1;
+
+public:
+    Socket() = default;
+    explicit Socket(int descriptor) : fd(descriptor) {}
+
+    ~Socket() {
+        close();
+    }
+
+    Socket(const Socket&) = delete;
+    Socket& operator=(const Socket&) = delete;
+
+    Socket(Socket&& other) noexcept : fd(other.fd) {
+        other.fd = -1;
+    }
+
+    Socket& operator=(Socket&& other) noexcept {
+        if (this != &other) {
+            close();
+            fd = other.fd;
+            other.fd = -1;
+        }
+        return *this;
+    }
+
+    int get_fd() const {
+        return fd;
+    }
+
+    bool is_open() const {
+        return fd >= 0;
+    }
+
+    void close() {
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+    }
+
+    // Despierta a otro hilo bloqueado en recv o accept sobre este socket
+    void shutdown() {
+        if (fd >= 0) ::shutdown(fd, SHUT_RDWR);
+    }
+
+    // MSG_NOSIGNAL: si el otro extremo murio se recibe una excepcion y no SIGPIPE
+    void send_all(const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t n = ::send(fd, data, size, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error(std::string("Connection lost while sending: ") + std::strerror(errno));
+            }
+            data += n;
+            size -= static_cast<size_t>(n);
+        }
+    }
+
+    // false si la conexion se cerro antes del primer byte; cerrarse a la mitad es un error
+    bool recv_all(char* data, size_t size) {
+        size_t done = 0;
+        while (done < size) {
+            ssize_t n = ::recv(fd, data + done, size - done, 0);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error(std::string("Connection lost while receiving: ") + std::strerror(errno));
+            }
+            if (n == 0) {
+                if (done == 0) return false;
+                throw std::runtime_error("Connection closed in the middle of a message");
+            }
+            done += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    // Cabecera y cuerpo salen en un solo send para no esperar a Nagle entre los dos
+    void send_message(uint8_t type, std::string_view body) {
+        if (body.size() > UINT32_MAX) throw std::runtime_error("Message too large");
+        std::string frame(5 + body.size(), '\0');
+        frame[0] = static_cast<char>(type);
+        for (int i = 0; i < 4; ++i) {
+            frame[1 + i] = static_cast<char>((body.size() >> (8 * i)) & 0xFF);
+        }
+        std::memcpy(&frame[5], body.data(), body.size());
+        send_all(frame.data(), frame.size());
+    }
+
+    // false si el otro extremo cerro la conexion entre dos mensajes
+    bool recv_message(uint8_t& type, std::string& body) {
+        char header[5];
+        if (!recv_all(header, sizeof(header))) return false;
+        type = static_cast<uint8_t>(header[0]);
+        uint32_t length = 0;
+        for (int i = 0; i < 4; ++i) {
+            length |= static_cast<uint32_t>(static_cast<unsigned char>(header[1 + i])) << (8 * i);
+        }
+        body.resize(length);
+        if (length > 0 && !recv_all(&body[0], length)) {
+            throw std::runtime_error("Connection closed in the middle of a message");
+        }
+        return true;
+    }
+
+    // IP local de una conexion TCP: la direccion por la que los demas procesos
+    // llegan a esta maquina cuando se escucha en 0.0.0.0
+    std::string local_host() const {
+        sockaddr_storage storage;
+        socklen_t length = sizeof(storage);
+        char host[NI_MAXHOST];
+        if (::getsockname(fd, reinterpret_cast<sockaddr*>(&storage), &length) != 0 ||
+            storage.ss_family == AF_UNIX ||
+            ::getnameinfo(reinterpret_cast<sockaddr*>(&storage), length, host, sizeof(host), nullptr, 0, NI_NUMERICHOST) != 0) {
+            return "127.0.0.1";
+        }
+        return host;
+    }
+};
+
+// Resuelve host:puerto con getaddrinfo; el llamador libera la lista
+inline addrinfo* resolve_tcp(const SocketAddress& address, bool passive) {
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (passive) hints.ai_flags = AI_PASSIVE;
+    addrinfo* result = nullptr;
+    int error = ::getaddrinfo(address.host.c_str(), std::to_string(address.port).c_str(), &hints, &result);
+    if (error != 0) {
+        throw std::runtime_error("Cannot resolve " + address.to_string() + ": " + ::gai_strerror(error));
+    }
+    return result;
+}
+
+inline sockaddr_un unix_socket_address(const SocketAddress& address) {
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, address.path.c_str(), address.path.size());
+    return addr;
+}
+
+class Listener {
+private:
+    Socket socket;
+    SocketAddress bound;
+
+public:
+    // Un socket unix que quedo de una ejecucion anterior se borra antes de escuchar
+    explicit Listener(const SocketAddress& address) : bound(address) {
+        if (address.is_unix) {
+            struct stat st;
+            if (::stat(address.path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+                ::unlink(address.path.c_str());
+            }
+            socket = Socket(::socket(AF_UNIX, SOCK_STREAM, 0));
+            sockaddr_un addr = unix_socket_address(address);
+            if (!socket.is_open() || ::bind(socket.get_fd(), reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+                throw std::runtime_error("Cannot listen on " + address.to_string() + ": " + std::strerror(errno));
+            }
+        } else {
+            addrinfo* result = resolve_tcp(address, true);
+            socket = Socket(::socket(result->ai_family, SOCK_STREAM, 0));
+            int reuse = 1;
+            if (socket.is_open()) ::setsockopt(socket.get_fd(), SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+            bool ok = socket.is_open() && ::bind(socket.get_fd(), result->ai_addr, result->ai_addrlen) == 0;
+            ::freeaddrinfo(result);
+            if (!ok) {
+                throw std::runtime_error("Cannot listen on " + address.to_string() + ": " + std::strerror(errno));
+            }
+            // Con el puerto 0 el sistema elige uno libre; se anuncia el real
+            sockaddr_storage storage;
+            socklen_t length = sizeof(storage);
+            if (::getsockname(socket.get_fd(), reinterpret_cast<sockaddr*>(&storage), &length) == 0) {
+                bound.port = ntohs(storage.ss_family == AF_INET6 ?
+                    reinterpret_cast<sockaddr_in6*>(&storage)->sin6_port :
+                    reinterpret_cast<sockaddr_in*>(&storage)->sin_port);
+            }
+        }
+        if (::listen(socket.get_fd(), SOMAXCONN) != 0) {
+            throw std::runtime_error("Cannot listen on " + address.to_string() + ": " + std::strerror(errno));
+        }
+    }
+
+    ~Listener() {
+        if (bound.is_unix && socket.is_open()) ::unlink(bound.path.c_str());
+    }
+
+    Listener(const Listener&) = delete;
+    Listener& operator=(const Listener&) = delete;
+
+    const SocketAddress& address() const {
+        return bound;
+    }
+
+    // Con watch, deja de esperar si esa otra conexion se cierra o recibe algo: un
+    // proceso que espera a otros no se queda colgado si el trabajo se cancela
+    Socket accept(const Socket* watch = nullptr) {
+        while (true) {
+            if (watch) {
+                pollfd fds[2] = {{socket.get_fd(), POLLIN, 0}, {watch->get_fd(), POLLIN, 0}};
+                if (::poll(fds, 2, -1) < 0) {
+                    if (errno == EINTR) continue;
+                    throw std::runtime_error("Failed to wait on " + bound.to_string() + ": " + std::strerror(errno));
+                }
+                if (fds[1].revents != 0) {
+                    throw std::runtime_error("Connection closed while waiting on " + bound.to_string());
+                }
+                if (fds[0].revents == 0) continue;
+            }
+            int fd = ::accept(socket.get_fd(), nullptr, nullptr);
+            if (fd >= 0) {
+                int one = 1;
+                if (!bound.is_unix) ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                return Socket(fd);
+            }
+            if (errno != EINTR) {
+                throw std::runtime_error("Failed to accept on " + bound.to_string() + ": " + std::strerror(errno));
+            }
+        }
+    }
+};
+
+// Conecta reintentando hasta timeout: el otro proceso puede no estar escuchando todavia
+inline Socket connect_socket(const SocketAddress& address, std::chrono::seconds timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (true) {
+        Socket socket;
+        bool connected = false;
+        if (address.is_unix) {
+            socket = Socket(::socket(AF_UNIX, SOCK_STREAM, 0));
+            sockaddr_un addr = unix_socket_address(address);
+            connected = socket.is_open() && ::connect(socket.get_fd(), reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+        } else {
+            addrinfo* result = resolve_tcp(address, false);
+            for (addrinfo* ai = result; ai && !connected; ai = ai->ai_next) {
+                socket = Socket(::socket(ai->ai_family, SOCK_STREAM, 0));
+                connected = socket.is_open() && ::connect(socket.get_fd(), ai->ai_addr, ai->ai_addrlen) == 0;
+            }
+            ::freeaddrinfo(result);
+            int one = 1;
+            if (connected) ::setsockopt(socket.get_fd(), IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        if (connected) return socket;
+        if (std::chrono::steady_clock::now() >= deadline) {
+            throw std::runtime_error("Cannot connect to " + address.to_string() + ": " + std::strerror(errno));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+}
+
+inline std::string encode_fields(const std::vector<std::string>& fields) {
+    std::string body;
+    for (size_t i = 0; i < fields.size(); ++i) {
+        if (i > 0) body += '\0';
+        body += fields[i];
+    }
+    return body;
+}
+
+inline std::vector<std::string> decode_fields(const std::string& body) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t end = body.find('\0', start);
+        if (end == std::string::npos) {
+            fields.push_back(body.substr(start));
+            return fields;
+        }
+        fields.push_back(body.substr(start, end - start));
+        start = end + 1;
+    }
+}
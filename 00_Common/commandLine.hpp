@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Separa los argumentos posicionales de las opciones "--nombre" o "--nombre=valor".
+// Las opciones pueden aparecer en cualquier posicion de la linea de comandos.
+struct CommandLine {
+    std::vector<std::string> positional;
+    std::unordered_map<std::string, std::string> options;
+
+    CommandLine(int argc, char* argv[]) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+                size_t eq = arg.find('=');
+                if (eq == std::string::npos) {
+                    options[arg.substr(2)] = "";
+                } else {
+                    options[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+                }
+            } else {
+                positional.push_back(arg);
+            }
+        }
+    }
+
+    bool has(const std::string& name) const {
+        return options.count(name) > 0;
+    }
+
+    std::string get(const std::string& name, const std::string& default_value = "") const {
+        auto it = options.find(name);
+        return it == options.end() ? default_value : it->second;
+    }
+};
@@ -0,0 +1,475 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "mappedFile.hpp"
+
+// Cada formato se compila solo si se pide, porque necesita enlazar su biblioteca:
+//   -DBDW_WITH_ZLIB -lz    gzip (incluidos gzip multi-miembro y BGZF)
+//   -DBDW_WITH_ZSTD -lzstd zstd
+//   -DBDW_WITH_LZ4 -llz4   lz4 (formato frame)
+#ifdef BDW_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef BDW_WITH_ZSTD
+#include <zstd.h>
+#endif
+#ifdef BDW_WITH_LZ4
+#include <lz4frame.h>
+#endif
+
+enum class Compression { NONE, GZIP, ZSTD, LZ4 };
+
+inline const char* compression_name(Compression type) {
+    switch (type) {
+        case Compression::GZIP: return "gzip";
+        case Compression::ZSTD: return "zstd";
+        case Compression::LZ4: return "lz4";
+        default: return "none";
+    }
+}
+
+// Detecta el formato por los bytes magicos del principio
+inline Compression detect_compression(std::string_view head) {
+    auto starts = [&](const char* magic, size_t n) {
+        return head.size() >= n && std::memcmp(head.data(), magic, n) == 0;
+    };
+    if (starts("\x1f\x8b", 2)) return Compression::GZIP;
+    if (starts("\x28\xb5\x2f\xfd", 4)) return Compression::ZSTD;
+    if (starts("\x04\x22\x4d\x18", 4)) return Compression::LZ4;
+    return Compression::NONE;
+}
+
+inline Compression detect_compression_file(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    char head[4] = {};
+    file.read(head, sizeof(head));
+    return detect_compression(std::string_view(head, static_cast<size_t>(file.gcount())));
+}
+
+// Descompresor en streaming de un formato. decode agrega a out todo lo que se
+// pueda descomprimir de la entrada; la entrada puede llegar en cualquier corte.
+class StreamDecoder {
+private:
+    static constexpr size_t OUT_STEP = 256 * 1024;
+
+    Compression type;
+    bool frame_done = true;  // La entrada termina en un limite de miembro/frame
+#ifdef BDW_WITH_ZLIB
+    z_stream zs;
+#endif
+#ifdef BDW_WITH_ZSTD
+    ZSTD_DStream* zstd = nullptr;
+#endif
+#ifdef BDW_WITH_LZ4
+    LZ4F_dctx* lz4 = nullptr;
+#endif
+
+    [[noreturn]] static void unsupported(Compression type, const char* flags) {
+        throw std::runtime_error(std::string(compression_name(type)) + " input requires building with " + flags);
+    }
+
+public:
+    explicit StreamDecoder(Compression format) : type(format) {
+        switch (type) {
+            case Compression::GZIP:
+#ifdef BDW_WITH_ZLIB
+                std::memset(&zs, 0, sizeof(zs));
+                // 15 + 32: ventana maxima y deteccion automatica de cabecera gzip/zlib
+                if (inflateInit2(&zs, 15 + 32) != Z_OK) throw std::runtime_error("inflateInit2 failed");
+                break;
+#else
+                unsupported(type, "-DBDW_WITH_ZLIB -lz");
+#endif
+            case Compression::ZSTD:
+#ifdef BDW_WITH_ZSTD
+                zstd = ZSTD_createDStream();
+                if (!zstd) throw std::runtime_error("ZSTD_createDStream failed");
+                ZSTD_initDStream(zstd);
+                break;
+#else
+                unsupported(type, "-DBDW_WITH_ZSTD -lzstd");
+#endif
+            case Compression::LZ4:
+#ifdef BDW_WITH_LZ4
+                if (LZ4F_isError(LZ4F_createDecompressionContext(&lz4, LZ4F_VERSION))) {
+                    throw std::runtime_error("LZ4F_createDecompressionContext failed");
+                }
+                break;
+#else
+                unsupported(type, "-DBDW_WITH_LZ4 -llz4");
+#endif
+            default:
+                throw std::invalid_argument("StreamDecoder needs a compressed format");
+        }
+    }
+
+    ~StreamDecoder() {
+#ifdef BDW_WITH_ZLIB
+        if (type == Compression::GZIP) inflateEnd(&zs);
+#endif
+#ifdef BDW_WITH_ZSTD
+        if (zstd) ZSTD_freeDStream(zstd);
+#endif
+#ifdef BDW_WITH_LZ4
+        if (lz4) LZ4F_freeDecompressionContext(lz4);
+#endif
+    }
+
+    StreamDecoder(const StreamDecoder&) = delete;
+    StreamDecoder& operator=(const StreamDecoder&) = delete;
+
+    void decode(const char* input, size_t size, std::string& out) {
+        switch (type) {
+#ifdef BDW_WITH_ZLIB
+            case Compression::GZIP: {
+                zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input));
+                zs.avail_in = static_cast<uInt>(size);
+                while (true) {
+                    size_t old = out.size();
+                    out.resize(old + OUT_STEP);
+                    zs.next_out = reinterpret_cast<Bytef*>(&out[old]);
+                    zs.avail_out = static_cast<uInt>(OUT_STEP);
+                    int ret = inflate(&zs, Z_NO_FLUSH);
+                    out.resize(old + OUT_STEP - zs.avail_out);
+                    if (ret == Z_STREAM_END) {
+                        frame_done = true;
+                        // Varios miembros gzip concatenados (pigz, bgzip): seguir con el siguiente
+                        if (zs.avail_in == 0) return;
+                        inflateReset(&zs);
+                        continue;
+                    }
+                    if (ret == Z_BUF_ERROR && zs.avail_in == 0) return;
+                    if (ret != Z_OK) {
+                        throw std::runtime_error(std::string("gzip decode error: ") + (zs.msg ? zs.msg : "corrupt data"));
+                    }
+                    frame_done = false;
+                    if (zs.avail_in == 0 && zs.avail_out != 0) return;
+                }
+            }
+#endif
+#ifdef BDW_WITH_ZSTD
+            case Compression::ZSTD: {
+                ZSTD_inBuffer in = {input, size, 0};
+                while (true) {
+                    size_t old = out.size();
+                    out.resize(old + OUT_STEP);
+                    ZSTD_outBuffer buffer = {&out[old], OUT_STEP, 0};
+                    size_t ret = ZSTD_decompressStream(zstd, &buffer, &in);
+                    out.resize(old + buffer.pos);
+                    if (ZSTD_isError(ret)) {
+                        throw std::runtime_error(std::string("zstd decode error: ") + ZSTD_getErrorName(ret));
+                    }
+                    frame_done = ret == 0;
+                    if (in.pos == in.size && buffer.pos < buffer.size) return;
+                }
+            }
+#endif
+#ifdef BDW_WITH_LZ4
+            case Compression::LZ4: {
+                while (true) {
+                    size_t old = out.size();
+                    out.resize(old + OUT_STEP);
+                    size_t produced = OUT_STEP;
+                    size_t consumed = size;
+                    size_t ret = LZ4F_decompress(lz4, &out[old], &produced, input, &consumed, nullptr);
+                    out.resize(old + produced);
+                    if (LZ4F_isError(ret)) {
+                        throw std::runtime_error(std::string("lz4 decode error: ") + LZ4F_getErrorName(ret));
+                    }
+                    input += consumed;
+                    size -= consumed;
+                    frame_done = ret == 0;
+                    if (size == 0 && produced < OUT_STEP) return;
+                }
+            }
+#endif
+            default:
+                (void)input;
+                (void)size;
+                (void)out;
+                return;
+        }
+    }
+
+    // Al terminar la entrada el ultimo miembro/frame debe estar completo
+    void finish() const {
+        if (!frame_done) {
+            throw std::runtime_error(std::string("truncated ") + compression_name(type) + " input");
+        }
+    }
+};
+
+// Lectura de un archivo comprimido como un flujo de bytes descomprimidos. La
+// descompresion corre en hilos propios (una etapa mas del pipeline, en paralelo
+// con la tokenizacion) y deja bloques en orden que read() va entregando.
+//
+// Si el archivo esta formado por frames independientes cuyo tamaño se conoce
+// sin descomprimir (gzip BGZF con el subcampo "BC", o zstd con varios frames),
+// los grupos de frames se descomprimen en paralelo con decode_threads hilos.
+// Si no, un solo hilo descomprime en streaming.
+class DecompressingReader {
+private:
+    static constexpr size_t INPUT_SLICE = 1024 * 1024;     // Entrada por llamada en modo streaming
+    static constexpr size_t OUTPUT_BLOCK = 4 * 1024 * 1024; // Tamaño de bloque publicado en modo streaming
+    static constexpr size_t GROUP_BYTES = 4 * 1024 * 1024;  // Entrada comprimida por tarea en modo paralelo
+
+    MappedFile input;
+    Compression type;
+    std::vector<std::pair<size_t, size_t>> groups;  // Grupos de frames [inicio, fin) en modo paralelo
+    size_t window;  // Bloques descomprimidos que pueden esperar a read()
+
+    std::vector<std::thread> decoders;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::map<size_t, std::string> ready;
+    size_t next_block = 0;             // Proximo bloque que entrega read()
+    size_t total_blocks = SIZE_MAX;    // Se conoce al terminar de descomprimir
+    bool stopping = false;
+    std::exception_ptr error;
+    std::atomic<size_t> next_group{0};
+    std::atomic<uint64_t> consumed{0};
+
+    std::string current;
+    size_t current_pos = 0;
+
+    // Tamaño del miembro gzip en pos si tiene el subcampo BGZF "BC", 0 si no
+    static size_t bgzf_member_size(std::string_view data, size_t pos) {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(data.data()) + pos;
+        size_t left = data.size() - pos;
+        if (left < 18 || p[0] != 0x1f || p[1] != 0x8b || p[2] != 8 || !(p[3] & 4)) return 0;
+        size_t xlen = p[10] | (p[11] << 8);
+        if (12 + xlen > left) return 0;
+        for (size_t i = 12; i + 4 <= 12 + xlen;) {
+            size_t slen = p[i + 2] | (p[i + 3] << 8);
+            if (p[i] == 'B' && p[i + 1] == 'C' && slen == 2 && i + 6 <= 12 + xlen) {
+                return (p[i + 4] | (p[i + 5] << 8)) + 1;
+            }
+            i += 4 + slen;
+        }
+        return 0;
+    }
+
+    // Limites de frames independientes; vacio si el archivo no se puede dividir
+    std::vector<size_t> find_frames() const {
+        std::string_view data = input.view();
+        std::vector<size_t> ends;
+        size_t pos = 0;
+        while (pos < data.size()) {
+            size_t size = 0;
+            if (type == Compression::GZIP) {
+                size = bgzf_member_size(data, pos);
+            }
+#ifdef BDW_WITH_ZSTD
+            if (type == Compression::ZSTD) {
+                size_t ret = ZSTD_findFrameCompressedSize(data.data() + pos, data.size() - pos);
+                size = ZSTD_isError(ret) ? 0 : ret;
+            }
+#endif
+            if (size == 0 || pos + size > data.size()) return {};
+            pos += size;
+            ends.push_back(pos);
+        }
+        return ends;
+    }
+
+    // Publica un bloque; espera si read() va demasiado atras
+    void publish(size_t index, std::string&& block) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.emplace(index, std::move(block));
+        cv.notify_all();
+    }
+
+    bool wait_window(size_t index) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&] { return index < next_block + window || stopping; });
+        return !stopping;
+    }
+
+    void fail(std::exception_ptr e) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error) error = e;
+        cv.notify_all();
+    }
+
+    void decode_streaming() {
+        try {
+            StreamDecoder decoder(type);
+            std::string_view data = input.view();
+            std::string block;
+            size_t index = 0;
+            for (size_t pos = 0; pos < data.size(); pos += INPUT_SLICE) {
+                size_t n = std::min(INPUT_SLICE, data.size() - pos);
+                decoder.decode(data.data() + pos, n, block);
+                consumed.fetch_add(n, std::memory_order_relaxed);
+                if (block.size() >= OUTPUT_BLOCK) {
+                    if (!wait_window(index)) return;
+                    publish(index++, std::move(block));
+                    block = std::string();
+                }
+            }
+            decoder.finish();
+            if (!block.empty()) {
+                if (!wait_window(index)) return;
+                publish(index++, std::move(block));
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            total_blocks = index;
+            cv.notify_all();
+        } catch (...) {
+            fail(std::current_exception());
+        }
+    }
+
+    void decode_groups() {
+        try {
+            size_t index;
+            while ((index = next_group.fetch_add(1)) < groups.size()) {
+                if (!wait_window(index)) return;
+                StreamDecoder decoder(type);
+                std::string block;
+                size_t size = groups[index].second - groups[index].first;
+                decoder.decode(input.view().data() + groups[index].first, size, block);
+                decoder.finish();
+                consumed.fetch_add(size, std::memory_order_relaxed);
+                publish(index, std::move(block));
+            }
+        } catch (...) {
+            fail(std::current_exception());
+        }
+    }
+
+public:
+    DecompressingReader(const std::string& path, size_t decode_threads)
+        : input(path), type(detect_compression(input.view().substr(0, 4))) {
+        if (type == Compression::NONE) {
+            throw std::invalid_argument("Not a compressed file: " + path);
+        }
+        StreamDecoder probe(type);  // Falla pronto si el formato no esta compilado
+
+        std::vector<size_t> ends = find_frames();
+        if (ends.size() > 1 && decode_threads > 1) {
+            // Se agrupan frames consecutivos hasta GROUP_BYTES de entrada por tarea
+            size_t start = 0;
+            for (size_t end : ends) {
+                if (end - start >= GROUP_BYTES || end == ends.back()) {
+                    groups.emplace_back(start, end);
+                    start = end;
+                }
+            }
+        }
+
+        if (groups.size() > 1) {
+            total_blocks = groups.size();
+            window = 2 * decode_threads;
+            for (size_t i = 0; i < decode_threads; ++i) {
+                decoders.emplace_back([this] { decode_groups(); });
+            }
+        } else {
+            groups.clear();
+            window = 2;
+            decoders.emplace_back([this] { decode_streaming(); });
+        }
+    }
+
+    ~DecompressingReader() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto& decoder : decoders) decoder.join();
+    }
+
+    DecompressingReader(const DecompressingReader&) = delete;
+    DecompressingReader& operator=(const DecompressingReader&) = delete;
+
+    Compression get_type() const {
+        return type;
+    }
+
+    bool is_parallel() const {
+        return !groups.empty();
+    }
+
+    size_t compressed_size() const {
+        return input.size();
+    }
+
+    // Bytes comprimidos ya descomprimidos (para el progreso)
+    uint64_t compressed_bytes_read() const {
+        return consumed.load(std::memory_order_relaxed);
+    }
+
+    // Copia hasta len bytes descomprimidos; solo devuelve menos al final del archivo
+    size_t read(char* buffer, size_t len) {
+        size_t done = 0;
+        while (done < len) {
+            if (current_pos == current.size()) {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&] { return ready.count(next_block) || next_block >= total_blocks || error; });
+                if (error) std::rethrow_exception(error);
+                if (!ready.count(next_block)) break;
+                current = std::move(ready[next_block]);
+                ready.erase(next_block);
+                next_block++;
+                current_pos = 0;
+                cv.notify_all();
+                continue;
+            }
+            size_t n = std::min(len - done, current.size() - current_pos);
+            std::memcpy(buffer + done, current.data() + current_pos, n);
+            current_pos += n;
+            done += n;
+        }
+        return done;
+    }
+};
+
+// Corta el flujo de source (cualquier tipo con size_t read(char*, size_t)) en
+// chunks de unos chunk_size bytes que terminan en un espacio en blanco, con la
+// misma logica de leftover que la lectura normal. on_chunk recibe el chunk y su
+// posicion en el flujo descomprimido; si devuelve false se deja de leer.
+template <typename Source, typename Callback>
+void read_chunks(Source& source, size_t chunk_size, Callback&& on_chunk) {
+    std::string leftover;
+    uint64_t offset = 0;
+    while (true) {
+        std::string chunk(chunk_size + 1, '\0');
+        size_t bytes_read = source.read(&chunk[0], chunk_size + 1);
+        chunk.resize(bytes_read);
+        if (bytes_read == 0) break;
+
+        if (!leftover.empty()) {
+            chunk = leftover + chunk;
+            leftover.clear();
+        }
+        if (bytes_read == chunk_size + 1 && !std::isspace(static_cast<unsigned char>(chunk.back()))) {
+            size_t last_space = chunk.find_last_of(" \t\n\r");
+            if (last_space != std::string::npos) {
+                leftover = chunk.substr(last_space + 1);
+                chunk.resize(last_space + 1);
+            }
+        }
+        size_t size = chunk.size();
+        if (!on_chunk(std::move(chunk), offset)) return;
+        offset += size;
+    }
+    if (!leftover.empty()) on_chunk(std::move(leftover), offset);
+}
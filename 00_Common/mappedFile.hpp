@@ -0,0 +1,78 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Archivo mapeado en memoria de solo lectura. Los trozos que se entregan a los
+// hilos son vistas (string_view) sobre el mapeo, por lo que no se copia ningun byte.
+class MappedFile {
+private:
+    int fd = -1;
+    const char* data = nullptr;
+    size_t length = 0;
+
+public:
+    explicit MappedFile(const std::string& path) {
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open file for mapping: " + path);
+        }
+
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Failed to stat file: " + path);
+        }
+        length = static_cast<size_t>(st.st_size);
+
+        // mmap no admite longitud 0; un archivo vacio se representa con una vista vacia
+        if (length > 0) {
+            void* addr = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("Failed to map file: " + path);
+            }
+            data = static_cast<const char*>(addr);
+            ::madvise(addr, length, MADV_SEQUENTIAL);
+        }
+    }
+
+    ~MappedFile() {
+        if (data) ::munmap(const_cast<char*>(data), length);
+        if (fd >= 0) ::close(fd);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::string_view view() const {
+        return std::string_view(data, length);
+    }
+
+    size_t size() const {
+        return length;
+    }
+};
+
+// Recorre text en trozos de aproximadamente chunk_size bytes. Cada corte se
+// extiende hasta el siguiente espacio en blanco para no partir palabras.
+template <typename Callback>
+void split_at_whitespace(std::string_view text, size_t chunk_size, Callback&& on_slice) {
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = std::min(pos + chunk_size, text.size());
+        while (end < text.size() && !std::isspace(static_cast<unsigned char>(text[end]))) {
+            ++end;
+        }
+        on_slice(text.substr(pos, end - pos));
+        pos = end;
+    }
+}
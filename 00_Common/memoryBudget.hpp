@@ -0,0 +1,128 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+// Convierte "4G", "512M", "64k" o "1073741824" a bytes (sufijos en base 1024)
+inline size_t parse_byte_size(const std::string& text) {
+    size_t pos = 0;
+    double value = std::stod(text, &pos);
+    std::string suffix = text.substr(pos);
+    if (!suffix.empty() && (suffix.back() == 'B' || suffix.back() == 'b')) suffix.pop_back();
+    if (!suffix.empty() && (suffix.back() == 'i')) suffix.pop_back();
+
+    double scale = 1;
+    if (!suffix.empty()) {
+        switch (std::toupper(static_cast<unsigned char>(suffix[0]))) {
+            case 'K': scale = 1024.0; break;
+            case 'M': scale = 1024.0 * 1024; break;
+            case 'G': scale = 1024.0 * 1024 * 1024; break;
+            case 'T': scale = 1024.0 * 1024 * 1024 * 1024; break;
+            default: throw std::invalid_argument("Invalid size suffix: " + text);
+        }
+        if (suffix.size() > 1) throw std::invalid_argument("Invalid size suffix: " + text);
+    }
+    if (value < 0) throw std::invalid_argument("Negative size: " + text);
+    return static_cast<size_t>(value * scale);
+}
+
+// Contabilidad de memoria en bytes por categoria con un presupuesto total.
+//
+// El presupuesto se reparte en dos partes: QUEUE_SHARE para los chunks leidos
+// que aun no se han terminado de procesar (la cola y los que estan en manos de
+// los hilos) y el resto para las estructuras de datos (tablas por hilo, indice y
+// diccionario). Los lectores se bloquean cuando la cola no cabe (backpressure) y
+// las estructuras se vuelcan a disco cuando superan su parte (spill).
+class MemoryBudget {
+public:
+    enum Category { QUEUE, TABLES, INDEX, DICTIONARY, NUM_CATEGORIES };
+
+    static constexpr double QUEUE_SHARE = 0.25;
+
+private:
+    size_t limit;
+    std::array<std::atomic<int64_t>, NUM_CATEGORIES> used;
+    std::mutex mutex;
+    std::condition_variable released;
+
+public:
+    explicit MemoryBudget(size_t limit_bytes) : limit(limit_bytes) {
+        for (auto& value : used) value.store(0);
+    }
+
+    size_t get_limit() const {
+        return limit;
+    }
+
+    size_t queue_limit() const {
+        return static_cast<size_t>(limit * QUEUE_SHARE);
+    }
+
+    size_t data_limit() const {
+        return limit - queue_limit();
+    }
+
+    void add(Category category, int64_t delta) {
+        used[category].fetch_add(delta, std::memory_order_relaxed);
+        if (delta < 0) notify();
+    }
+
+    // Para categorias que se miden completas cada vez (por ejemplo el diccionario)
+    void set(Category category, size_t bytes) {
+        int64_t previous = used[category].exchange(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+        if (static_cast<int64_t>(bytes) < previous) notify();
+    }
+
+    size_t get(Category category) const {
+        int64_t value = used[category].load(std::memory_order_relaxed);
+        return value > 0 ? static_cast<size_t>(value) : 0;
+    }
+
+    size_t total() const {
+        size_t sum = 0;
+        for (int c = 0; c < NUM_CATEGORIES; ++c) sum += get(static_cast<Category>(c));
+        return sum;
+    }
+
+    size_t data_used() const {
+        return get(TABLES) + get(INDEX) + get(DICTIONARY);
+    }
+
+    bool data_over_budget() const {
+        return data_used() > data_limit();
+    }
+
+    // Reserva bytes de cola. Bloquea mientras no quepan; un chunk siempre cabe si
+    // la cola esta vacia, para que un chunk mayor que la cuota no bloquee para siempre.
+    // Devuelve false si stop se activo mientras esperaba.
+    bool acquire_queue(size_t bytes, const std::atomic<bool>& stop) {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stop) {
+            size_t queued = get(QUEUE);
+            if (queued == 0 || queued + bytes <= queue_limit()) {
+                used[QUEUE].fetch_add(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+                return true;
+            }
+            // Espera con timeout para poder observar stop sin otra notificacion
+            released.wait_for(lock, std::chrono::milliseconds(50));
+        }
+        return false;
+    }
+
+    void release_queue(size_t bytes) {
+        add(QUEUE, -static_cast<int64_t>(bytes));
+    }
+
+private:
+    void notify() {
+        std::lock_guard<std::mutex> lock(mutex);
+        released.notify_all();
+    }
+};
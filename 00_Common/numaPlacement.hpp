@@ -0,0 +1,176 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// ---------------------------------------------------------------------------
+// Colocacion NUMA (--numa). La topologia se lee de /sys/devices/system/node y
+// los hilos y la memoria se colocan con llamadas al sistema directas
+// (sched_setaffinity, mbind, get_mempolicy), sin libnuma. En una maquina sin
+// NUMA, o sin /sys, hay un solo nodo con todas las CPUs permitidas.
+// ---------------------------------------------------------------------------
+
+// Constantes de linux/mempolicy.h con nombre propio para no chocar con esa cabecera
+constexpr int NUMA_MPOL_PREFERRED = 1;
+constexpr int NUMA_MPOL_F_NODE = 1;
+constexpr int NUMA_MPOL_F_ADDR = 2;
+constexpr unsigned NUMA_MPOL_MF_MOVE = 2;
+
+// "0-3,8-11" -> {0, 1, 2, 3, 8, 9, 10, 11}
+inline std::vector<int> parse_cpu_list(const std::string& text) {
+    std::vector<int> cpus;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t comma = text.find(',', start);
+        if (comma == std::string::npos) comma = text.size();
+        std::string range = text.substr(start, comma - start);
+        start = comma + 1;
+        if (range.empty() || range == "\n") continue;
+        size_t dash = range.find('-');
+        int first = std::stoi(range.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+inline std::string format_cpu_list(const std::vector<int>& cpus) {
+    std::string text;
+    for (size_t i = 0; i < cpus.size(); ++i) {
+        size_t last = i;
+        while (last + 1 < cpus.size() && cpus[last + 1] == cpus[last] + 1) last++;
+        if (!text.empty()) text += ',';
+        text += std::to_string(cpus[i]);
+        if (last > i) text += '-' + std::to_string(cpus[last]);
+        i = last;
+    }
+    return text;
+}
+
+// Fija el hilo actual a un conjunto de CPUs. false si el sistema no lo permite.
+inline bool pin_current_thread(const std::vector<int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+    }
+    return ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) == 0;
+}
+
+// Pide que las paginas de [addr, addr + len) esten en el nodo node_id; las que ya
+// existan en otro nodo se mueven. addr tiene que estar alineado a pagina. Es
+// MPOL_PREFERRED: si el nodo se queda sin memoria se usa otro en lugar de fallar.
+inline bool bind_memory_to_node(void* addr, size_t len, int node_id) {
+    if (node_id < 0 || len == 0) return false;
+    std::vector<unsigned long> mask(static_cast<size_t>(node_id) / (8 * sizeof(unsigned long)) + 1, 0);
+    mask[node_id / (8 * sizeof(unsigned long))] |= 1UL << (node_id % (8 * sizeof(unsigned long)));
+    // El kernel descuenta uno de maxnode
+    unsigned long max_node = mask.size() * 8 * sizeof(unsigned long) + 1;
+    return ::syscall(SYS_mbind, addr, len, NUMA_MPOL_PREFERRED, mask.data(), max_node, NUMA_MPOL_MF_MOVE) == 0;
+}
+
+// Nodo en que esta la pagina de addr, o -1 si no se puede saber
+inline int memory_node(const void* addr) {
+    int node = -1;
+    if (::syscall(SYS_get_mempolicy, &node, nullptr, 0UL, const_cast<void*>(addr),
+                  NUMA_MPOL_F_NODE | NUMA_MPOL_F_ADDR) != 0) {
+        return -1;
+    }
+    return node;
+}
+
+class NumaTopology {
+private:
+    std::vector<int> ids;                // Id del kernel de cada nodo (puede haber huecos)
+    std::vector<std::vector<int>> cpus;  // CPUs permitidas a este proceso en cada nodo
+
+public:
+    // Solo cuentan los nodos con alguna CPU en la afinidad del proceso (taskset, cgroups)
+    static NumaTopology detect() {
+        std::vector<int> allowed;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (::sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                if (CPU_ISSET(cpu, &set)) allowed.push_back(cpu);
+            }
+        }
+
+        std::vector<int> node_ids;
+        if (DIR* dir = ::opendir("/sys/devices/system/node")) {
+            while (dirent* entry = ::readdir(dir)) {
+                std::string name = entry->d_name;
+                if (name.size() > 4 && name.compare(0, 4, "node") == 0 &&
+                    std::all_of(name.begin() + 4, name.end(), ::isdigit)) {
+                    node_ids.push_back(std::stoi(name.substr(4)));
+                }
+            }
+            ::closedir(dir);
+        }
+        std::sort(node_ids.begin(), node_ids.end());
+
+        NumaTopology topology;
+        for (int id : node_ids) {
+            std::ifstream file("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+            std::string list;
+            std::getline(file, list);
+            std::vector<int> node_cpus;
+            for (int cpu : parse_cpu_list(list)) {
+                if (allowed.empty() || std::binary_search(allowed.begin(), allowed.end(), cpu)) {
+                    node_cpus.push_back(cpu);
+                }
+            }
+            if (node_cpus.empty()) continue;
+            topology.ids.push_back(id);
+            topology.cpus.push_back(node_cpus);
+        }
+        if (topology.ids.empty()) {
+            topology.ids.push_back(0);
+            topology.cpus.push_back(allowed);
+        }
+        return topology;
+    }
+
+    size_t num_nodes() const {
+        return ids.size();
+    }
+
+    int node_id(size_t node) const {
+        return ids[node];
+    }
+
+    const std::vector<int>& node_cpus(size_t node) const {
+        return cpus[node];
+    }
+
+    // Nodos que se usan con num_threads hilos: uno por hilo como mucho, para que
+    // ningun nodo reciba chunks sin tener hilos que los procesen
+    size_t used_nodes(size_t num_threads) const {
+        return std::max<size_t>(1, std::min(num_nodes(), num_threads));
+    }
+
+    // Los hilos se reparten en bloques contiguos: con 8 hilos y 2 nodos, 0-3 al
+    // nodo 0 y 4-7 al nodo 1
+    size_t node_of_thread(size_t thread, size_t num_threads) const {
+        return thread * used_nodes(num_threads) / std::max<size_t>(1, num_threads);
+    }
+
+    // CPU de un hilo con --numa=cores: el k-esimo hilo de un nodo va a su k-esima CPU
+    int cpu_of_thread(size_t thread, size_t num_threads) const {
+        size_t node = node_of_thread(thread, num_threads);
+        size_t first = thread;
+        while (first > 0 && node_of_thread(first - 1, num_threads) == node) first--;
+        const std::vector<int>& list = cpus[node];
+        return list.empty() ? -1 : list[(thread - first) % list.size()];
+    }
+};
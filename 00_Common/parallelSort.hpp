@@ -0,0 +1,57 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+// Ordena [first, last) con varios hilos: cada hilo ordena un tramo contiguo y
+// despues los tramos se fusionan de dos en dos, tambien en paralelo, hasta
+// quedar uno. Con pocos elementos o un solo hilo es un std::sort normal.
+template <typename RandomIt, typename Compare>
+void parallel_sort(RandomIt first, RandomIt last, Compare comp, size_t threads) {
+    // Por debajo de este tamano crear hilos cuesta mas de lo que ahorra
+    constexpr size_t MIN_ELEMENTS_PER_THREAD = 1 << 14;
+
+    size_t count = static_cast<size_t>(std::distance(first, last));
+    threads = std::min(threads, count / MIN_ELEMENTS_PER_THREAD);
+    if (threads <= 1) {
+        std::sort(first, last, comp);
+        return;
+    }
+
+    std::vector<size_t> bounds;
+    for (size_t i = 0; i <= threads; ++i) {
+        bounds.push_back(count * i / threads);
+    }
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < threads; ++i) {
+        workers.emplace_back([&, i]() {
+            std::sort(first + bounds[i], first + bounds[i + 1], comp);
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    while (bounds.size() > 2) {
+        std::vector<size_t> merged_bounds;
+        workers.clear();
+        for (size_t i = 0; i + 1 < bounds.size(); i += 2) {
+            merged_bounds.push_back(bounds[i]);
+            if (i + 2 < bounds.size()) {
+                workers.emplace_back([&, i]() {
+                    std::inplace_merge(first + bounds[i], first + bounds[i + 1], first + bounds[i + 2], comp);
+                });
+            }
+        }
+        // Con un numero impar de tramos el ultimo pasa sin fusionar a la siguiente ronda
+        merged_bounds.push_back(bounds.back());
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        bounds = merged_bounds;
+    }
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Rango de bytes [begin, end) de un archivo
+struct ByteRange {
+    uint64_t begin = 0;
+    uint64_t end = 0;
+
+    uint64_t size() const {
+        return end - begin;
+    }
+};
+
+// Lectura de rangos de un archivo con pread. No tiene posicion compartida, asi que
+// varios hilos pueden leer rangos distintos del mismo archivo a la vez.
+class RangeReader {
+private:
+    int fd = -1;
+    uint64_t length = 0;
+    std::string path;
+
+    // Bytes que se leen de una vez al buscar el siguiente espacio en blanco
+    static constexpr size_t SCAN_BLOCK = 4096;
+
+public:
+    explicit RangeReader(const std::string& file_path) : path(file_path) {
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open input file: " + path);
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Failed to stat file: " + path);
+        }
+        length = static_cast<uint64_t>(st.st_size);
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+
+    ~RangeReader() {
+        if (fd >= 0) ::close(fd);
+    }
+
+    RangeReader(const RangeReader&) = delete;
+    RangeReader& operator=(const RangeReader&) = delete;
+
+    uint64_t size() const {
+        return length;
+    }
+
+    const std::string& get_path() const {
+        return path;
+    }
+
+    // Lee exactamente size bytes desde offset (menos si se llega al final del archivo)
+    size_t read_at(uint64_t offset, char* buffer, size_t size) const {
+        size_t done = 0;
+        while (done < size) {
+            ssize_t n = ::pread(fd, buffer + done, size - done, static_cast<off_t>(offset + done));
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error("Failed to read file: " + path);
+            }
+            if (n == 0) break;
+            done += static_cast<size_t>(n);
+        }
+        return done;
+    }
+
+    void read(const ByteRange& range, std::string& out) const {
+        out.resize(range.size());
+        out.resize(read_at(range.begin, out.data(), range.size()));
+    }
+
+    // Primera posicion >= pos que es un espacio en blanco, o el final del archivo
+    uint64_t next_whitespace(uint64_t pos) const {
+        char block[SCAN_BLOCK];
+        while (pos < length) {
+            size_t n = read_at(pos, block, SCAN_BLOCK);
+            if (n == 0) break;
+            for (size_t i = 0; i < n; ++i) {
+                if (std::isspace(static_cast<unsigned char>(block[i]))) return pos + i;
+            }
+            pos += n;
+        }
+        return length;
+    }
+
+    // Los mismos cortes que split_at_whitespace sobre el archivo completo: cada
+    // rango mide unos chunk_size bytes y termina en un espacio en blanco, asi que
+    // los tokens son los mismos que con una lectura secuencial. Solo lee unos pocos
+    // bytes por corte.
+    std::vector<ByteRange> split(size_t chunk_size) const {
+        std::vector<ByteRange> ranges;
+        uint64_t pos = 0;
+        while (pos < length) {
+            uint64_t end = next_whitespace(std::min<uint64_t>(pos + std::max<size_t>(chunk_size, 1), length));
+            ranges.push_back({pos, end});
+            pos = end;
+        }
+        return ranges;
+    }
+};
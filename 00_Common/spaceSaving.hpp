@@ -0,0 +1,193 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Sketch Space-Saving para las palabras mas frecuentes con memoria fija.
+//
+// Guarda como mucho capacity contadores. Una palabra nueva con el sketch lleno
+// reemplaza a la de menor conteo y hereda ese conteo como error. Cada conteo es
+// una cota superior y count - error una cota inferior del valor real; cualquier
+// palabra que aparezca mas de total / capacity veces esta en el sketch.
+class SpaceSaving {
+public:
+    struct Counter {
+        std::string term;
+        uint64_t count = 0;
+        uint64_t error = 0;
+    };
+
+private:
+    size_t capacity;
+    // Los contadores no se mueven nunca (el vector se reserva entero), asi que las
+    // claves del mapa pueden ser vistas sobre sus strings
+    std::vector<Counter> counters;
+    std::unordered_map<std::string_view, uint32_t> slots;
+    // Min-heap de indices de contadores por conteo; position[i] es su posicion
+    std::vector<uint32_t> heap;
+    std::vector<uint32_t> position;
+    uint64_t total = 0;
+    // Bytes reservados por las palabras guardadas
+    size_t term_bytes = 0;
+
+    bool less(uint32_t a, uint32_t b) const {
+        return counters[a].count < counters[b].count;
+    }
+
+    void swap_nodes(size_t a, size_t b) {
+        std::swap(heap[a], heap[b]);
+        position[heap[a]] = static_cast<uint32_t>(a);
+        position[heap[b]] = static_cast<uint32_t>(b);
+    }
+
+    void sift_up(size_t i) {
+        while (i > 0) {
+            size_t parent = (i - 1) / 2;
+            if (!less(heap[i], heap[parent])) break;
+            swap_nodes(i, parent);
+            i = parent;
+        }
+    }
+
+    void sift_down(size_t i) {
+        while (true) {
+            size_t smallest = i;
+            size_t left = 2 * i + 1;
+            size_t right = left + 1;
+            if (left < heap.size() && less(heap[left], heap[smallest])) smallest = left;
+            if (right < heap.size() && less(heap[right], heap[smallest])) smallest = right;
+            if (smallest == i) return;
+            swap_nodes(i, smallest);
+            i = smallest;
+        }
+    }
+
+public:
+    explicit SpaceSaving(size_t max_counters) : capacity(std::max<size_t>(1, max_counters)) {
+        counters.reserve(capacity);
+        slots.reserve(capacity);
+        heap.reserve(capacity);
+        position.reserve(capacity);
+    }
+
+    SpaceSaving(const SpaceSaving&) = delete;
+    SpaceSaving& operator=(const SpaceSaving&) = delete;
+    SpaceSaving(SpaceSaving&&) = default;
+    SpaceSaving& operator=(SpaceSaving&&) = default;
+
+    // Devuelve true si la palabra no estaba en el sketch
+    bool add(std::string_view term, uint64_t count = 1, uint64_t error = 0) {
+        total += count;
+        auto it = slots.find(term);
+        if (it != slots.end()) {
+            counters[it->second].count += count;
+            counters[it->second].error += error;
+            sift_down(position[it->second]);
+            return false;
+        }
+
+        if (counters.size() < capacity) {
+            uint32_t slot = static_cast<uint32_t>(counters.size());
+            counters.push_back({std::string(term), count, error});
+            term_bytes += counters[slot].term.capacity();
+            slots.emplace(counters[slot].term, slot);
+            position.push_back(static_cast<uint32_t>(heap.size()));
+            heap.push_back(slot);
+            sift_up(heap.size() - 1);
+            return true;
+        }
+
+        // Reemplaza al contador minimo, que hereda su conteo como error
+        uint32_t slot = heap[0];
+        Counter& victim = counters[slot];
+        slots.erase(victim.term);
+        uint64_t floor = victim.count;
+        term_bytes -= victim.term.capacity();
+        victim.term.assign(term.data(), term.size());
+        term_bytes += victim.term.capacity();
+        victim.count = floor + count;
+        victim.error = floor + error;
+        slots.emplace(victim.term, slot);
+        sift_down(0);
+        return true;
+    }
+
+    // Conteo minimo del sketch: cota del error de las palabras que no estan
+    uint64_t min_count() const {
+        return counters.size() < capacity || heap.empty() ? 0 : counters[heap[0]].count;
+    }
+
+    // Fusion de sketches: se suman los contadores comunes, las palabras que faltan
+    // en uno de los dos cargan el minimo del otro como error y se quedan los
+    // capacity mayores (resumenes fusionables de Agarwal et al.)
+    void merge(const SpaceSaving& other) {
+        uint64_t own_floor = min_count();
+        uint64_t other_floor = other.min_count();
+        std::unordered_map<std::string_view, const Counter*> theirs;
+        theirs.reserve(other.counters.size());
+        for (const auto& counter : other.counters) theirs.emplace(counter.term, &counter);
+
+        std::vector<Counter> merged;
+        merged.reserve(counters.size() + other.counters.size());
+        for (const auto& counter : counters) {
+            auto it = theirs.find(counter.term);
+            if (it != theirs.end()) {
+                merged.push_back({counter.term, counter.count + it->second->count, counter.error + it->second->error});
+                theirs.erase(it);
+            } else {
+                merged.push_back({counter.term, counter.count + other_floor, counter.error + other_floor});
+            }
+        }
+        for (const auto& counter : other.counters) {
+            if (theirs.count(counter.term)) {
+                merged.push_back({counter.term, counter.count + own_floor, counter.error + own_floor});
+            }
+        }
+
+        uint64_t merged_total = total + other.total;
+        size_t keep = std::min(capacity, merged.size());
+        std::partial_sort(merged.begin(), merged.begin() + keep, merged.end(),
+                          [](const Counter& a, const Counter& b) { return a.count > b.count; });
+        merged.resize(keep);
+
+        SpaceSaving result(capacity);
+        for (auto& counter : merged) result.add(counter.term, counter.count, counter.error);
+        result.total = merged_total;
+        *this = std::move(result);
+    }
+
+    // Los n contadores con mayor conteo, de mayor a menor
+    std::vector<Counter> top(size_t n) const {
+        std::vector<Counter> result(counters.begin(), counters.end());
+        size_t keep = std::min(n, result.size());
+        std::partial_sort(result.begin(), result.begin() + keep, result.end(), [](const Counter& a, const Counter& b) {
+            return a.count != b.count ? a.count > b.count : a.term < b.term;
+        });
+        result.resize(keep);
+        return result;
+    }
+
+    size_t size() const {
+        return counters.size();
+    }
+
+    // Memoria aproximada; no crece con el vocabulario una vez lleno el sketch
+    size_t memory_bytes() const {
+        return counters.capacity() * (sizeof(Counter) + 2 * sizeof(uint32_t)) + term_bytes +
+               slots.bucket_count() * sizeof(void*) +
+               slots.size() * (sizeof(std::string_view) + sizeof(uint32_t) + 2 * sizeof(void*));
+    }
+
+    size_t get_capacity() const {
+        return capacity;
+    }
+
+    uint64_t get_total() const {
+        return total;
+    }
+};
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Almacen de bytes por bloques. Las vistas que devuelve store() siguen siendo
+// validas hasta que se destruye o se vacia el arena.
+class Arena {
+private:
+    static constexpr size_t BLOCK_SIZE = 1 << 20;
+
+    std::vector<std::unique_ptr<char[]>> blocks;
+    size_t used = 0;
+    size_t capacity = 0;
+    size_t total_bytes = 0;
+
+public:
+    std::string_view store(std::string_view text) {
+        if (used + text.size() > capacity) {
+            capacity = std::max(BLOCK_SIZE, text.size());
+            blocks.emplace_back(new char[capacity]);
+            used = 0;
+            total_bytes += capacity;
+        }
+        char* dst = blocks.back().get() + used;
+        std::memcpy(dst, text.data(), text.size());
+        used += text.size();
+        return std::string_view(dst, text.size());
+    }
+
+    void clear() {
+        blocks.clear();
+        used = capacity = total_bytes = 0;
+    }
+
+    size_t memory_bytes() const {
+        return total_bytes;
+    }
+};
+
+// Diccionario de terminos concurrente: asigna a cada termino distinto un id
+// uint32_t denso (0, 1, 2, ...) para que las tablas de conteo y de postings se
+// indexen por entero. El texto de cada termino se guarda una sola vez en el arena
+// de su shard; cada shard tiene su propio mutex para repartir la contencion.
+class TermDictionary {
+private:
+    static constexpr size_t NUM_SHARDS = 64;
+    static constexpr size_t SEGMENT_BITS = 16;
+    static constexpr size_t SEGMENT_SIZE = size_t(1) << SEGMENT_BITS;
+    static constexpr size_t MAX_SEGMENTS = size_t(1) << (32 - SEGMENT_BITS);
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string_view, uint32_t> ids;
+        Arena arena;
+    };
+
+    std::unique_ptr<Shard[]> shards;
+    std::atomic<uint32_t> next_id{0};
+    std::atomic<uint64_t> current_generation{0};
+    std::atomic<size_t> bytes_used{0};
+
+    // Coste aproximado de una entrada del mapa de un shard (nodo + bucket)
+    static constexpr size_t ENTRY_OVERHEAD = sizeof(std::string_view) + sizeof(uint32_t) + 3 * sizeof(void*);
+
+    // Tabla id -> termino en segmentos de 64K entradas que se reservan bajo demanda,
+    // asi las vistas ya publicadas nunca se mueven.
+    std::unique_ptr<std::atomic<std::string_view*>[]> segments;
+
+    void publish(uint32_t id, std::string_view term) {
+        auto& slot = segments[id >> SEGMENT_BITS];
+        std::string_view* segment = slot.load(std::memory_order_acquire);
+        if (!segment) {
+            auto* fresh = new std::string_view[SEGMENT_SIZE];
+            if (slot.compare_exchange_strong(segment, fresh, std::memory_order_acq_rel)) {
+                segment = fresh;
+                bytes_used.fetch_add(SEGMENT_SIZE * sizeof(std::string_view), std::memory_order_relaxed);
+            } else {
+                delete[] fresh;
+            }
+        }
+        segment[id & (SEGMENT_SIZE - 1)] = term;
+    }
+
+public:
+    TermDictionary()
+        : shards(new Shard[NUM_SHARDS]), segments(new std::atomic<std::string_view*>[MAX_SEGMENTS]) {
+        for (size_t i = 0; i < MAX_SEGMENTS; ++i) {
+            segments[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~TermDictionary() {
+        for (size_t i = 0; i < MAX_SEGMENTS; ++i) {
+            delete[] segments[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    TermDictionary(const TermDictionary&) = delete;
+    TermDictionary& operator=(const TermDictionary&) = delete;
+
+    uint32_t intern(std::string_view term) {
+        Shard& shard = shards[std::hash<std::string_view>{}(term) % NUM_SHARDS];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.ids.find(term);
+        if (it != shard.ids.end()) {
+            return it->second;
+        }
+        std::string_view stored = shard.arena.store(term);
+        // Se cuentan los bytes usados y no los bloques reservados del arena, que solo
+        // ocupan memoria real a medida que se escriben
+        bytes_used.fetch_add(term.size() + ENTRY_OVERHEAD, std::memory_order_relaxed);
+        uint32_t id = next_id.fetch_add(1, std::memory_order_relaxed);
+        publish(id, stored);
+        shard.ids.emplace(stored, id);
+        return id;
+    }
+
+    std::string_view term(uint32_t id) const {
+        return segments[id >> SEGMENT_BITS].load(std::memory_order_acquire)[id & (SEGMENT_SIZE - 1)];
+    }
+
+    size_t size() const {
+        return next_id.load(std::memory_order_relaxed);
+    }
+
+    // Se incrementa en cada clear(); las caches de los hilos lo usan para invalidarse
+    uint64_t generation() const {
+        return current_generation.load(std::memory_order_acquire);
+    }
+
+    // Solo debe llamarse cuando ningun otro hilo esta usando el diccionario
+    void clear() {
+        for (size_t i = 0; i < NUM_SHARDS; ++i) {
+            shards[i].ids.clear();
+            shards[i].arena.clear();
+        }
+        for (size_t i = 0; i < MAX_SEGMENTS; ++i) {
+            delete[] segments[i].exchange(nullptr, std::memory_order_relaxed);
+        }
+        next_id.store(0, std::memory_order_relaxed);
+        bytes_used.store(0, std::memory_order_relaxed);
+        current_generation.fetch_add(1, std::memory_order_release);
+    }
+
+    // Reserva sitio para unos terms terminos en total, repartidos entre los shards,
+    // para que los mapas no se rehagan mientras los hilos internan terminos
+    void reserve(size_t terms) {
+        for (size_t i = 0; i < NUM_SHARDS; ++i) {
+            std::lock_guard<std::mutex> lock(shards[i].mutex);
+            shards[i].ids.reserve(terms / NUM_SHARDS + 1);
+        }
+    }
+
+    // Bytes aproximados del diccionario (arenas, mapas y tabla id -> termino).
+    // Se puede consultar desde cualquier hilo sin bloquear.
+    size_t memory_bytes() const {
+        return bytes_used.load(std::memory_order_relaxed);
+    }
+};
+
+// Cache privada de cada hilo delante del diccionario compartido. La mayoria de
+// los tokens son palabras ya vistas, asi que se resuelven sin tomar ningun mutex.
+// Las claves apuntan al arena del diccionario, no al buffer del tokenizador.
+class TermCache {
+private:
+    TermDictionary& dictionary;
+    std::unordered_map<std::string_view, uint32_t> ids;
+    uint64_t generation;
+
+public:
+    explicit TermCache(TermDictionary& dict) : dictionary(dict), generation(dict.generation()) {}
+
+    // Descarta la cache si el diccionario se vacio desde la ultima llamada
+    void sync() {
+        uint64_t current = dictionary.generation();
+        if (current != generation) {
+            ids.clear();
+            generation = current;
+        }
+    }
+
+    size_t memory_bytes() const {
+        return ids.size() * (sizeof(std::string_view) + sizeof(uint32_t) + 2 * sizeof(void*)) +
+               ids.bucket_count() * sizeof(void*);
+    }
+
+    uint32_t lookup(std::string_view term) {
+        auto it = ids.find(term);
+        if (it != ids.end()) {
+            return it->second;
+        }
+        uint32_t id = dictionary.intern(term);
+        ids.emplace(dictionary.term(id), id);
+        return id;
+    }
+};
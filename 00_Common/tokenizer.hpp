@@ -0,0 +1,488 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define BDW_TOKENIZER_X86 1
+#endif
+
+// Clases de byte equivalentes a isspace/ispunct/isupper en el locale "C".
+// Los bytes >= 0x80 solo se marcan como BYTE_HIGH (parte de una secuencia UTF-8).
+enum ByteClass : uint8_t {
+    BYTE_SPACE = 1,
+    BYTE_PUNCT = 2,
+    BYTE_UPPER = 4,
+    BYTE_HIGH = 8,
+};
+
+struct ByteTables {
+    std::array<uint8_t, 256> classes{};
+    std::array<char, 256> lower{};
+
+    ByteTables() {
+        for (int c = 0; c < 256; ++c) {
+            uint8_t cls = 0;
+            if (c == ' ' || (c >= '\t' && c <= '\r')) cls |= BYTE_SPACE;
+            if ((c >= '!' && c <= '/') || (c >= ':' && c <= '@') ||
+                (c >= '[' && c <= '`') || (c >= '{' && c <= '~')) cls |= BYTE_PUNCT;
+            if (c >= 'A' && c <= 'Z') cls |= BYTE_UPPER;
+            if (c >= 0x80) cls |= BYTE_HIGH;
+            classes[c] = cls;
+            lower[c] = static_cast<char>((cls & BYTE_UPPER) ? c + ('a' - 'A') : c);
+        }
+    }
+};
+
+inline const ByteTables& byte_tables() {
+    static const ByteTables tables;
+    return tables;
+}
+
+// ---------------------------------------------------------------------------
+// Kernels de clasificacion. Cada uno produce, por cada bloque de 64 bytes, una
+// mascara con un bit por byte que es espacio en blanco, otra con los bytes en
+// 'A'..'Z' y otra con los bytes no ASCII. Las versiones SIMD se compilan con atributos target, de modo que el
+// binario funciona en cualquier x86-64 y elige el kernel en tiempo de ejecucion.
+// ---------------------------------------------------------------------------
+
+enum class TokenizerKernel { Scalar, SSE2, AVX2 };
+
+inline const char* kernel_name(TokenizerKernel kernel) {
+    switch (kernel) {
+        case TokenizerKernel::AVX2: return "avx2";
+        case TokenizerKernel::SSE2: return "sse2";
+        default: return "scalar";
+    }
+}
+
+inline bool kernel_supported(TokenizerKernel kernel) {
+#ifdef BDW_TOKENIZER_X86
+    if (kernel == TokenizerKernel::AVX2) return __builtin_cpu_supports("avx2");
+    return true; // SSE2 forma parte de x86-64
+#else
+    return kernel == TokenizerKernel::Scalar;
+#endif
+}
+
+inline TokenizerKernel best_kernel() {
+    static const TokenizerKernel kernel = [] {
+        if (kernel_supported(TokenizerKernel::AVX2)) return TokenizerKernel::AVX2;
+        if (kernel_supported(TokenizerKernel::SSE2)) return TokenizerKernel::SSE2;
+        return TokenizerKernel::Scalar;
+    }();
+    return kernel;
+}
+
+// Bloque parcial (len < 64) o arquitectura sin SIMD
+inline void classify_block_scalar(const unsigned char* p, size_t len, uint64_t& space, uint64_t& upper, uint64_t& high) {
+    const auto& classes = byte_tables().classes;
+    space = 0;
+    upper = 0;
+    high = 0;
+    for (size_t i = 0; i < len; ++i) {
+        uint8_t cls = classes[p[i]];
+        space |= uint64_t(cls & BYTE_SPACE) << i;
+        upper |= uint64_t((cls & BYTE_UPPER) >> 2) << i;
+        high |= uint64_t((cls & BYTE_HIGH) >> 3) << i;
+    }
+}
+
+inline void classify_scalar(const unsigned char* p, size_t blocks, uint64_t* space, uint64_t* upper, uint64_t* high) {
+    for (size_t b = 0; b < blocks; ++b) {
+        classify_block_scalar(p + b * 64, 64, space[b], upper[b], high[b]);
+    }
+}
+
+inline void fold_ascii_scalar(char* dst, const char* src, size_t n) {
+    const auto& lower = byte_tables().lower;
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] = lower[static_cast<unsigned char>(src[i])];
+    }
+}
+
+#ifdef BDW_TOKENIZER_X86
+
+// b en [lo, hi] como comparacion sin signo: min(b - lo, hi - lo) == b - lo
+__attribute__((target("sse2")))
+inline __m128i in_range_sse2(__m128i b, char lo, char hi) {
+    __m128i shifted = _mm_sub_epi8(b, _mm_set1_epi8(lo));
+    return _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(static_cast<char>(hi - lo))), shifted);
+}
+
+__attribute__((target("sse2")))
+inline void classify_sse2(const unsigned char* p, size_t blocks, uint64_t* space, uint64_t* upper, uint64_t* high) {
+    for (size_t b = 0; b < blocks; ++b) {
+        uint64_t sp = 0, up = 0, hi = 0;
+        for (int k = 0; k < 4; ++k) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + b * 64 + k * 16));
+            __m128i is_space = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), in_range_sse2(v, '\t', '\r'));
+            __m128i is_upper = in_range_sse2(v, 'A', 'Z');
+            sp |= uint64_t(static_cast<uint16_t>(_mm_movemask_epi8(is_space))) << (k * 16);
+            up |= uint64_t(static_cast<uint16_t>(_mm_movemask_epi8(is_upper))) << (k * 16);
+            hi |= uint64_t(static_cast<uint16_t>(_mm_movemask_epi8(v))) << (k * 16);
+        }
+        space[b] = sp;
+        upper[b] = up;
+        high[b] = hi;
+    }
+}
+
+__attribute__((target("sse2")))
+inline void fold_ascii_sse2(char* dst, const char* src, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i delta = _mm_and_si128(in_range_sse2(v, 'A', 'Z'), _mm_set1_epi8(0x20));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_add_epi8(v, delta));
+    }
+    fold_ascii_scalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2")))
+inline __m256i in_range_avx2(__m256i b, char lo, char hi) {
+    __m256i shifted = _mm256_sub_epi8(b, _mm256_set1_epi8(lo));
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8(static_cast<char>(hi - lo))), shifted);
+}
+
+__attribute__((target("avx2")))
+inline void classify_avx2(const unsigned char* p, size_t blocks, uint64_t* space, uint64_t* upper, uint64_t* high) {
+    for (size_t b = 0; b < blocks; ++b) {
+        __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + b * 64));
+        __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + b * 64 + 32));
+        __m256i blank = _mm256_set1_epi8(' ');
+        __m256i space_lo = _mm256_or_si256(_mm256_cmpeq_epi8(lo, blank), in_range_avx2(lo, '\t', '\r'));
+        __m256i space_hi = _mm256_or_si256(_mm256_cmpeq_epi8(hi, blank), in_range_avx2(hi, '\t', '\r'));
+        space[b] = uint64_t(static_cast<uint32_t>(_mm256_movemask_epi8(space_lo))) |
+                   (uint64_t(static_cast<uint32_t>(_mm256_movemask_epi8(space_hi))) << 32);
+        upper[b] = uint64_t(static_cast<uint32_t>(_mm256_movemask_epi8(in_range_avx2(lo, 'A', 'Z')))) |
+                   (uint64_t(static_cast<uint32_t>(_mm256_movemask_epi8(in_range_avx2(hi, 'A', 'Z')))) << 32);
+        high[b] = uint64_t(static_cast<uint32_t>(_mm256_movemask_epi8(lo))) |
+                  (uint64_t(static_cast<uint32_t>(_mm256_movemask_epi8(hi))) << 32);
+    }
+}
+
+__attribute__((target("avx2")))
+inline void fold_ascii_avx2(char* dst, const char* src, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256i delta = _mm256_and_si256(in_range_avx2(v, 'A', 'Z'), _mm256_set1_epi8(0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_add_epi8(v, delta));
+    }
+    fold_ascii_sse2(dst + i, src + i, n - i);
+}
+
+#endif
+
+// ---------------------------------------------------------------------------
+// Normalizacion UTF-8 para texto en espanol. Solo se aplica a los tokens que
+// contienen algun byte >= 0x80, que se detectan con la mascara de bytes no ASCII;
+// los tokens ASCII siguen el camino rapido sin ningun coste adicional.
+// ---------------------------------------------------------------------------
+
+enum NormalizeMode : unsigned {
+    NORMALIZE_NONE = 0,
+    NORMALIZE_CASE = 1,     // "Á" -> "á", "Ñ" -> "ñ" (Latin-1)
+    NORMALIZE_ACCENTS = 2,  // "á" -> "a", "ü" -> "u"; la "ñ" se conserva
+    NORMALIZE_PUNCT = 4,    // recorta "¿", "¡", "«", "»", rayas, comillas tipograficas y "…"
+    NORMALIZE_DEFAULT = NORMALIZE_CASE | NORMALIZE_PUNCT,
+    NORMALIZE_ALL = NORMALIZE_CASE | NORMALIZE_ACCENTS | NORMALIZE_PUNCT,
+};
+
+// Acepta "none", "all" o una lista separada por comas de "case", "accents", "punct"
+inline unsigned parse_normalize_mode(const std::string& spec) {
+    if (spec.empty() || spec == "default") return NORMALIZE_DEFAULT;
+    unsigned mode = NORMALIZE_NONE;
+    size_t pos = 0;
+    while (pos <= spec.size()) {
+        size_t comma = spec.find(',', pos);
+        if (comma == std::string::npos) comma = spec.size();
+        std::string item = spec.substr(pos, comma - pos);
+        if (item == "case") mode |= NORMALIZE_CASE;
+        else if (item == "accents") mode |= NORMALIZE_ACCENTS;
+        else if (item == "punct") mode |= NORMALIZE_PUNCT;
+        else if (item == "all") mode |= NORMALIZE_ALL;
+        else if (item != "none") throw std::invalid_argument("Unknown normalize mode: " + item);
+        pos = comma + 1;
+    }
+    return mode;
+}
+
+inline std::string normalize_mode_name(unsigned mode) {
+    if (mode == NORMALIZE_NONE) return "none";
+    std::string name;
+    if (mode & NORMALIZE_CASE) name += "case,";
+    if (mode & NORMALIZE_ACCENTS) name += "accents,";
+    if (mode & NORMALIZE_PUNCT) name += "punct,";
+    name.pop_back();
+    return name;
+}
+
+// Signos de puntuacion espanoles y tipograficos que se recortan con NORMALIZE_PUNCT
+inline size_t spanish_punct_length(const unsigned char* p, size_t available) {
+    if (available >= 2 && p[0] == 0xC2) {
+        // ¡ « » ¿
+        if (p[1] == 0xA1 || p[1] == 0xAB || p[1] == 0xBB || p[1] == 0xBF) return 2;
+    }
+    if (available >= 3 && p[0] == 0xE2 && p[1] == 0x80) {
+        // – — ‘ ’ “ ” …
+        switch (p[2]) {
+            case 0x93: case 0x94: case 0x98: case 0x99:
+            case 0x9C: case 0x9D: case 0xA6: return 3;
+        }
+    }
+    return 0;
+}
+
+// Igual que spanish_punct_length pero para la secuencia que termina justo antes de end
+inline size_t spanish_punct_length_before(const unsigned char* begin, const unsigned char* end) {
+    size_t available = static_cast<size_t>(end - begin);
+    if (available >= 2 && spanish_punct_length(end - 2, 2) == 2) return 2;
+    if (available >= 3 && spanish_punct_length(end - 3, 3) == 3) return 3;
+    return 0;
+}
+
+// Letras Latin-1 codificadas como 0xC3 XX. accent_fold[XX - 0x80] es la letra ASCII
+// (en minuscula) sin diacritico, o 0 si la letra se deja como esta.
+struct Latin1Tables {
+    std::array<char, 64> accent_fold{};
+
+    Latin1Tables() {
+        const char* upper = "AAAAAAACEEEEIIII" "DNOOOOO\0OUUUUY\0\0";  // 0x80..0x9F
+        const char* lower = "aaaaaaaceeeeiiii" "dnooooo\0ouuuuy\0y";  // 0xA0..0xBF
+        for (int i = 0; i < 32; ++i) {
+            char u = upper[i];
+            char l = lower[i];
+            accent_fold[i] = u ? static_cast<char>(u + ('a' - 'A')) : 0;
+            accent_fold[32 + i] = l;
+        }
+        // Se conservan "Æ/æ", "Ð/ð" y "Ñ/ñ"
+        for (int keep : {0x06, 0x10, 0x11}) {
+            accent_fold[keep] = 0;
+            accent_fold[32 + keep] = 0;
+        }
+    }
+};
+
+inline const Latin1Tables& latin1_tables() {
+    static const Latin1Tables tables;
+    return tables;
+}
+
+// Tokenizador sin asignaciones: separa por espacios en blanco, recorta la
+// puntuacion de los extremos y pasa a minusculas. Con NORMALIZE_NONE produce
+// exactamente los mismos tokens que el bucle istringstream >> word + ispunct +
+// ::tolower que usaban los process_chunk, con cualquiera de los kernels.
+//
+// Cada hilo debe tener su propio Tokenizer. La vista que recibe el callback apunta
+// al texto original o al buffer interno y solo es valida durante la llamada.
+class Tokenizer {
+private:
+    using ClassifyFn = void (*)(const unsigned char*, size_t, uint64_t*, uint64_t*, uint64_t*);
+    using FoldFn = void (*)(char*, const char*, size_t);
+
+    // Bloques de 64 bytes clasificados por lote (4 KB de texto)
+    static constexpr size_t BATCH_BLOCKS = 64;
+
+    TokenizerKernel kernel;
+    unsigned normalize;
+    ClassifyFn classify = classify_scalar;
+    FoldFn fold = fold_ascii_scalar;
+    std::string scratch;
+
+    // Recorta y normaliza el token text[start, end). seen es el OR de las clases
+    // de sus bytes (BYTE_UPPER y BYTE_HIGH).
+    template <typename Callback>
+    void emit(std::string_view text, size_t start, size_t end, uint8_t seen, Callback&& on_token) {
+        if ((seen & BYTE_HIGH) && normalize != NORMALIZE_NONE) {
+            emit_utf8(text, start, end, on_token);
+            return;
+        }
+
+        const auto& classes = byte_tables().classes;
+        while (start < end && (classes[static_cast<unsigned char>(text[start])] & BYTE_PUNCT)) ++start;
+        while (end > start && (classes[static_cast<unsigned char>(text[end - 1])] & BYTE_PUNCT)) --end;
+        if (start == end) return;
+
+        if (!(seen & BYTE_UPPER)) {
+            on_token(text.substr(start, end - start));
+            return;
+        }
+
+        scratch.resize(end - start);
+        fold(&scratch[0], text.data() + start, end - start);
+        on_token(std::string_view(scratch));
+    }
+
+    // Camino lento para tokens con bytes no ASCII. Las secuencias UTF-8 invalidas
+    // se copian tal cual, sin partirlas.
+    template <typename Callback>
+    void emit_utf8(std::string_view text, size_t start, size_t end, Callback&& on_token) {
+        const auto& tables = byte_tables();
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(text.data());
+        const bool strip_punct = (normalize & NORMALIZE_PUNCT) != 0;
+
+        while (start < end) {
+            size_t len = (tables.classes[bytes[start]] & BYTE_PUNCT) ? 1
+                       : strip_punct ? spanish_punct_length(bytes + start, end - start) : 0;
+            if (len == 0) break;
+            start += len;
+        }
+        while (end > start) {
+            size_t len = (tables.classes[bytes[end - 1]] & BYTE_PUNCT) ? 1
+                       : strip_punct ? spanish_punct_length_before(bytes + start, bytes + end) : 0;
+            if (len == 0) break;
+            end -= len;
+        }
+        if (start == end) return;
+
+        const auto& accent_fold = latin1_tables().accent_fold;
+        scratch.clear();
+        for (size_t i = start; i < end; ++i) {
+            unsigned char c = bytes[i];
+            if (c < 0x80) {
+                scratch.push_back(tables.lower[c]);
+                continue;
+            }
+            if (c == 0xC3 && i + 1 < end && (bytes[i + 1] & 0xC0) == 0x80) {
+                unsigned char next = bytes[++i];
+                if ((normalize & NORMALIZE_ACCENTS) && accent_fold[next - 0x80]) {
+                    scratch.push_back(accent_fold[next - 0x80]);
+                    continue;
+                }
+                // Mayusculas Latin-1 (U+00C0..U+00DE salvo U+00D7 "×")
+                if ((normalize & NORMALIZE_CASE) && next <= 0x9E && next != 0x97) {
+                    next += 0x20;
+                }
+                scratch.push_back(static_cast<char>(c));
+                scratch.push_back(static_cast<char>(next));
+                continue;
+            }
+            scratch.push_back(static_cast<char>(c));
+        }
+        on_token(std::string_view(scratch));
+    }
+
+    template <typename Callback>
+    void tokenize_scalar(std::string_view text, Callback&& on_token) {
+        const auto& classes = byte_tables().classes;
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(text.data());
+        const size_t n = text.size();
+        size_t pos = 0;
+
+        while (pos < n) {
+            while (pos < n && (classes[bytes[pos]] & BYTE_SPACE)) ++pos;
+            if (pos == n) break;
+
+            size_t start = pos;
+            uint8_t seen = 0;
+            while (pos < n && !(classes[bytes[pos]] & BYTE_SPACE)) {
+                seen |= classes[bytes[pos]];
+                ++pos;
+            }
+            emit(text, start, pos, seen, on_token);
+        }
+    }
+
+    // Recorre las mascaras de espacios: cada token empieza en un bit 0 tras un 1
+    // y termina en el siguiente bit 1. Los tokens pueden cruzar bloques y lotes.
+    template <typename Callback>
+    void tokenize_masks(std::string_view text, Callback&& on_token) {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(text.data());
+        const size_t n = text.size();
+        uint64_t space[BATCH_BLOCKS];
+        uint64_t upper[BATCH_BLOCKS];
+        uint64_t high[BATCH_BLOCKS];
+
+        bool in_token = false;
+        uint8_t seen = 0;
+        size_t start = 0;
+
+        for (size_t batch = 0; batch < n; batch += BATCH_BLOCKS * 64) {
+            size_t batch_len = std::min(BATCH_BLOCKS * 64, n - batch);
+            size_t full_blocks = batch_len / 64;
+            classify(bytes + batch, full_blocks, space, upper, high);
+            size_t blocks = full_blocks;
+            if (batch_len % 64) {
+                size_t tail = batch_len % 64;
+                classify_block_scalar(bytes + batch + full_blocks * 64, tail, space[blocks], upper[blocks], high[blocks]);
+                space[blocks] |= ~uint64_t(0) << tail; // fuera del texto cuenta como espacio
+                blocks++;
+            }
+
+            for (size_t b = 0; b < blocks; ++b) {
+                const size_t base = batch + b * 64;
+                uint64_t sp = space[b];
+                uint64_t up = upper[b];
+                uint64_t hi = high[b];
+                uint64_t from = ~uint64_t(0); // bits aun no consumidos del bloque
+
+                while (true) {
+                    if (in_token) {
+                        uint64_t ends = sp & from;
+                        if (!ends) {
+                            seen |= token_flags(up, hi, from);
+                            break;
+                        }
+                        unsigned e = __builtin_ctzll(ends);
+                        seen |= token_flags(up, hi, from & ((uint64_t(1) << e) - 1));
+                        emit(text, start, base + e, seen, on_token);
+                        in_token = false;
+                        from = ~uint64_t(0) << e;
+                    } else {
+                        uint64_t starts = ~sp & from;
+                        if (!starts) break;
+                        unsigned s0 = __builtin_ctzll(starts);
+                        start = base + s0;
+                        in_token = true;
+                        seen = 0;
+                        from = ~uint64_t(0) << s0;
+                    }
+                }
+            }
+        }
+
+        if (in_token) {
+            emit(text, start, n, seen, on_token);
+        }
+    }
+
+    static uint8_t token_flags(uint64_t upper, uint64_t high, uint64_t range) {
+        return ((upper & range) ? BYTE_UPPER : 0) | ((high & range) ? BYTE_HIGH : 0);
+    }
+
+public:
+    explicit Tokenizer(unsigned normalize_mode = NORMALIZE_DEFAULT, TokenizerKernel selected = best_kernel())
+        : kernel(selected), normalize(normalize_mode) {
+        if (!kernel_supported(kernel)) kernel = TokenizerKernel::Scalar;
+#ifdef BDW_TOKENIZER_X86
+        if (kernel == TokenizerKernel::AVX2) {
+            classify = classify_avx2;
+            fold = fold_ascii_avx2;
+        } else if (kernel == TokenizerKernel::SSE2) {
+            classify = classify_sse2;
+            fold = fold_ascii_sse2;
+        }
+#endif
+    }
+
+    TokenizerKernel get_kernel() const {
+        return kernel;
+    }
+
+    template <typename Callback>
+    void tokenize(std::string_view text, Callback&& on_token) {
+        if (kernel == TokenizerKernel::Scalar) {
+            tokenize_scalar(text, on_token);
+        } else {
+            tokenize_masks(text, on_token);
+        }
+    }
+};
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Colas de tareas por hilo con robo de trabajo. Cada hilo saca tareas del final de
+// su propia cola (LIFO, lo ultimo que genero suele estar caliente en cache) y,
+// si esta vacia, roba del principio de la cola de otro hilo. Las tareas pueden
+// venir de fuera (submit, repartidas por turnos) o del propio hilo (push), por
+// ejemplo al dividir un archivo grande en rangos.
+//
+// pop bloquea mientras no hay tareas; devuelve false cuando ya se llamo a close(),
+// no quedan tareas y ningun hilo esta ejecutando una que pueda generar mas.
+template <typename Task>
+class WorkStealingDeques {
+private:
+    struct alignas(64) WorkerQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        bool busy = false;  // Solo lo toca el hilo duenio
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::atomic<size_t> queued{0};
+    std::atomic<size_t> busy_workers{0};
+    std::atomic<size_t> next_queue{0};
+    std::mutex idle_mutex;
+    std::condition_variable idle_cv;
+    bool closed = false;
+
+    bool take_own(WorkerQueue& queue, Task& task) {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) return false;
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        return true;
+    }
+
+    bool steal(WorkerQueue& queue, Task& task) {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) return false;
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        return true;
+    }
+
+    bool take(size_t worker, Task& task) {
+        if (queued.load(std::memory_order_acquire) == 0) return false;
+        bool found = take_own(*queues[worker], task);
+        for (size_t i = 1; !found && i < queues.size(); ++i) {
+            found = steal(*queues[(worker + i) % queues.size()], task);
+        }
+        if (found) queued.fetch_sub(1, std::memory_order_acq_rel);
+        return found;
+    }
+
+    void wake_one() {
+        { std::lock_guard<std::mutex> lock(idle_mutex); }
+        idle_cv.notify_one();
+    }
+
+public:
+    explicit WorkStealingDeques(size_t workers) {
+        for (size_t i = 0; i < (workers > 0 ? workers : 1); ++i) {
+            queues.push_back(std::make_unique<WorkerQueue>());
+        }
+    }
+
+    size_t num_workers() const {
+        return queues.size();
+    }
+
+    // Tarea generada por el propio hilo worker
+    void push(size_t worker, Task&& task) {
+        {
+            std::lock_guard<std::mutex> lock(queues[worker]->mutex);
+            queues[worker]->tasks.push_back(std::move(task));
+        }
+        queued.fetch_add(1, std::memory_order_acq_rel);
+        wake_one();
+    }
+
+    // Tarea externa (por ejemplo del recorrido de directorios)
+    void submit(Task&& task) {
+        push(next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size(), std::move(task));
+    }
+
+    // Saca la siguiente tarea para worker; al llamarla se da por terminada la anterior
+    bool pop(size_t worker, Task& task) {
+        WorkerQueue& self = *queues[worker];
+        if (!self.busy) {
+            self.busy = true;
+            busy_workers.fetch_add(1, std::memory_order_acq_rel);
+        }
+        while (true) {
+            if (take(worker, task)) return true;
+
+            std::unique_lock<std::mutex> lock(idle_mutex);
+            self.busy = false;
+            if (busy_workers.fetch_sub(1, std::memory_order_acq_rel) == 1) idle_cv.notify_all();
+            idle_cv.wait(lock, [this] {
+                return queued.load(std::memory_order_acquire) > 0 ||
+                       (closed && busy_workers.load(std::memory_order_acquire) == 0);
+            });
+            // Otro hilo puede haberse llevado la tarea que lo desperto: solo se termina
+            // si ya no puede llegar ninguna mas, si no se vuelve a intentar
+            if (closed && queued.load(std::memory_order_acquire) == 0 &&
+                busy_workers.load(std::memory_order_acquire) == 0) {
+                return false;
+            }
+            self.busy = true;
+            busy_workers.fetch_add(1, std::memory_order_acq_rel);
+        }
+    }
+
+    // No habra mas tareas externas
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(idle_mutex);
+            closed = true;
+        }
+        idle_cv.notify_all();
+    }
+};
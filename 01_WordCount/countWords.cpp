@@ -9,115 +9,611 @@
 #include <algorithm>
 #include <atomic>
 #include <filesystem>
-#include <queue>
 #include <condition_variable>
 #include <sstream>
 #include <iomanip>
+#include <exception>
+#include <memory>
+#include <shared_mutex>
+#include <string_view>
+#include <charconv>
 
-#include <unordered_set>
+#include "../00_Common/asyncReader.hpp"
+#include "../00_Common/boundedQueue.hpp"
+#include "../00_Common/bufferedWriter.hpp"
+#include "../00_Common/checkpoint.hpp"
+#include "../00_Common/cluster.hpp"
+#include "../00_Common/commandLine.hpp"
+#include "../00_Common/compressedInput.hpp"
+#include "../00_Common/hyperLogLog.hpp"
+#include "../00_Common/mappedFile.hpp"
+#include "../00_Common/numaPlacement.hpp"
+#include "../00_Common/memoryBudget.hpp"
+#include "../00_Common/parallelSort.hpp"
+#include "../00_Common/rangeReader.hpp"
+#include "../00_Common/spaceSaving.hpp"
+#include "../00_Common/termDictionary.hpp"
+#include "../00_Common/tokenizer.hpp"
 
 using namespace std;
 
-class ThreadSafeQueue {
-private:
-    queue<pair<string, size_t>> queue_t;
-    std::mutex mutex;
-    condition_variable cv;
-    bool finished = false;
+// Trozo de texto a procesar. En modo --mmap solo guarda una vista sobre el
+// archivo mapeado; con --async-io es duenio del buffer alineado en el que se leyo
+// y en modo normal es duenio de los bytes leidos.
+struct Chunk {
+    size_t id = 0;
+    // Bytes reservados en la cuota de cola del presupuesto (0 para vistas mmap)
+    size_t accounted = 0;
+    // Con --numa, nodo en cuya memoria se leyo y a cuya cola va; SIZE_MAX si el
+    // lector no decide donde queda el buffer (va a la cola menos llena)
+    size_t node = SIZE_MAX;
+    string owned;
+    string_view mapped;
+    ReadBlock block;
 
-public:
-    void push(const string& data, size_t chunk_id) {
-        unique_lock<std::mutex> lock(mutex);
-        queue_t.push(make_pair(data, chunk_id));
-        cv.notify_one();
+    string_view text() const {
+        if (mapped.data()) return mapped;
+        return block.buffer ? block.text() : string_view(owned);
     }
+};
 
-    bool pop(pair<string, size_t>& item) {
-        unique_lock<std::mutex> lock(mutex);
-        cv.wait(lock, [this] { return !queue_t.empty() || finished; });
-        
-        if (queue_t.empty() && finished) {
-            return false;
-        }
-        
-        item = queue_t.front();
-        queue_t.pop();
-        return true;
+// Cola acotada entre el lector y los hilos (ver boundedQueue.hpp)
+using ChunkQueue = BoundedQueue<Chunk>;
+
+// Conteos de un hilo indexados por id de termino (ver TermDictionary)
+using CountTable = vector<uint64_t>;
+
+// Contadores de un nodo con --numa. Un chunk es remoto si su buffer estaba en
+// otro nodo que el hilo que lo proceso.
+struct NodeCounters {
+    int node_id = 0;
+    atomic<uint64_t> chunks{0};
+    atomic<uint64_t> bytes{0};
+    atomic<uint64_t> words{0};
+    atomic<uint64_t> remote_chunks{0};
+
+    void record(string_view chunk, uint64_t chunk_words) {
+        chunks.fetch_add(1, memory_order_relaxed);
+        bytes.fetch_add(chunk.size(), memory_order_relaxed);
+        words.fetch_add(chunk_words, memory_order_relaxed);
+        int node = chunk.empty() ? node_id : memory_node(chunk.data());
+        if (node >= 0 && node != node_id) remote_chunks.fetch_add(1, memory_order_relaxed);
     }
+};
 
-    void finish() {
-        unique_lock<std::mutex> lock(mutex);
-        finished = true;
-        cv.notify_all();
+// Orden de las lineas del resultado (--sort)
+enum class OutputOrder { FIRST_SEEN, TERM, COUNT };
+
+OutputOrder parse_output_order(const string& name) {
+    if (name.empty()) return OutputOrder::FIRST_SEEN;
+    if (name == "term") return OutputOrder::TERM;
+    if (name == "count") return OutputOrder::COUNT;
+    throw runtime_error("Unknown sort order: " + name + " (expected term or count)");
+}
+
+// Particion de un termino con --partitions: FNV-1a de 64 bits, que cualquier
+// consumidor puede recalcular sin depender de std::hash
+size_t partition_of(string_view term, size_t partitions) {
+    uint64_t h = 14695981039346656037ULL;
+    for (unsigned char c : term) {
+        h ^= c;
+        h *= 1099511628211ULL;
     }
+    return static_cast<size_t>(h % partitions);
+}
+
+// Nombre del archivo de la particion i: resultados.txt.part-00003
+string partition_path(const string& filename, size_t i) {
+    string number = to_string(i);
+    return filename + ".part-" + string(number.size() < 5 ? 5 - number.size() : 0, '0') + number;
+}
+
+void write_count_line(BufferedWriter& writer, string_view term, uint64_t count) {
+    writer.write(term);
+    writer.put(' ');
+    writer.write_uint(count);
+    writer.put('\n');
+}
+
+// Checkpoints periodicos (--checkpoint-interval) y --resume. fields guarda la
+// entrada y las opciones que deciden los cortes en chunks: al reanudar tienen que
+// coincidir con las del checkpoint para que los ids de chunk signifiquen lo mismo.
+struct CountCheckpoint {
+    string path;
+    CheckpointFile fields;
+    chrono::seconds interval{0};  // 0: solo se escribe en los spills
+    chrono::steady_clock::time_point next_time;
 
-    bool is_empty() {
-        unique_lock<std::mutex> lock(mutex);
-        return queue_t.empty();
+    bool due() const {
+        return interval.count() > 0 && chrono::steady_clock::now() >= next_time;
     }
 };
 
-class GlobalInvertedIndex {
+class GlobalWordCount {
 private:
-    unordered_map<string, unordered_set<string>> index;
-    std::mutex mutex;
+    size_t num_workers;
+    MemoryBudget& budget;
+    TermDictionary dictionary;
+    // Tabla privada de cada hilo; solo la toca su duenio salvo en spill y reduce
+    vector<CountTable> worker_counts;
+    // Ultimos bytes informados al presupuesto por cada hilo (tabla + cache)
+    vector<size_t> reported_bytes;
+    // Terminos distintos vistos por cada hilo; no se vacian en los spills
+    vector<HyperLogLog> worker_distinct;
+    // Resultado final indexado por id, despues de reduce
+    CountTable totals;
+    // Los hilos mantienen un shared_lock mientras procesan un chunk; spill toma el
+    // lock exclusivo para vaciar a la vez todas las tablas y el diccionario
+    shared_mutex epoch_mutex;
+    // Spills esperando el lock exclusivo; mientras haya alguno no empiezan chunks
+    size_t pending_spills = 0;
+    std::mutex spill_mutex;
+    condition_variable spill_done;
+    atomic<uint64_t> total_words{0};
+    // Solo con checkpoints: chunks cuyos conteos ya estan en las tablas o en el
+    // archivo temporal, y sus bytes. Durante un spill ningun hilo tiene un chunk a
+    // medias, asi que el checkpoint que se escribe ahi cuadra con el archivo temporal.
+    CountCheckpoint* checkpoint = nullptr;
+    CompletedSet done_chunks;
+    uint64_t done_bytes = 0;
+    std::mutex done_mutex;
+
+    bool checkpoint_due() const {
+        return checkpoint && checkpoint->due();
+    }
+
+    void start_spill() {
+        lock_guard<std::mutex> lock(spill_mutex);
+        pending_spills++;
+    }
+
+    void finish_spill() {
+        {
+            lock_guard<std::mutex> lock(spill_mutex);
+            pending_spills--;
+        }
+        spill_done.notify_all();
+    }
+
+    // Se llama con el lock exclusivo, despues de un spill que llego entero a disco
+    void save_checkpoint(const string& temp_file) {
+        CheckpointFile state = checkpoint->fields;
+        uint64_t spill_bytes = 0;
+        if (filesystem::exists(temp_file)) {
+            sync_file(temp_file);
+            spill_bytes = filesystem::file_size(temp_file);
+        }
+        state.set("spill", {to_string(spill_bytes)});
+        state.set("progress", {to_string(total_words.load()), to_string(done_bytes)});
+        state.set("done", {done_chunks.to_string()});
+        state.save(checkpoint->path);
+        checkpoint->next_time = chrono::steady_clock::now() + checkpoint->interval;
+        cout << "\nCheckpoint: " << done_chunks.size() << " chunks counted" << endl;
+    }
+
+    // Suma las tablas de todos los hilos y anade las lineas al archivo temporal.
+    // Se llama con el lock exclusivo.
+    void write_spill(const string& temp_file) {
+        BufferedWriter file(temp_file, true);
+        for (uint32_t id = 0; id < dictionary.size(); ++id) {
+            uint64_t count = 0;
+            for (const auto& counts : worker_counts) {
+                if (id < counts.size()) count += counts[id];
+            }
+            if (count > 0) write_count_line(file, dictionary.term(id), count);
+        }
+        file.close();
+    }
+
+    // Vacia tablas y diccionario despues de un spill. El diccionario volvera a
+    // llenarse hasta el mismo limite o hasta el total de palabras distintas: se
+    // reserva ya para no rehacer los mapas.
+    void clear_tables() {
+        for (auto& counts : worker_counts) {
+            CountTable().swap(counts);
+        }
+        size_t spilled_terms = dictionary.size();
+        dictionary.clear();
+        dictionary.reserve(min<uint64_t>(spilled_terms, estimate_unique_words()));
+        fill(reported_bytes.begin(), reported_bytes.end(), 0);
+        budget.set(MemoryBudget::TABLES, 0);
+        budget.set(MemoryBudget::DICTIONARY, dictionary.memory_bytes());
+    }
 
 public:
-    void merge(const unordered_map<string, unordered_set<string>>& local_index) {
-        unique_lock<std::mutex> lock(mutex);
-        for (const auto& [word, doc_ids] : local_index) {
-            index[word].insert(doc_ids.begin(), doc_ids.end());
+    GlobalWordCount(size_t workers, MemoryBudget& memory_budget)
+        : num_workers(max<size_t>(1, workers)), budget(memory_budget),
+          worker_counts(num_workers), reported_bytes(num_workers, 0), worker_distinct(num_workers) {}
+
+    TermDictionary& get_dictionary() {
+        return dictionary;
+    }
+
+    void enable_checkpoints(CountCheckpoint& state) {
+        checkpoint = &state;
+        checkpoint->next_time = chrono::steady_clock::now() + checkpoint->interval;
+    }
+
+    // Estado de un checkpoint anterior (--resume). Las palabras del archivo temporal
+    // vuelven a pasar por el HyperLogLog para que la estimacion las cuente.
+    void restore(const CompletedSet& chunks, uint64_t words, uint64_t bytes, const string& temp_file) {
+        done_chunks = chunks;
+        done_bytes = bytes;
+        total_words = words;
+        ifstream file(temp_file);
+        string word;
+        uint64_t count;
+        while (file >> word >> count) {
+            worker_distinct[0].add(word);
+        }
+    }
+
+    // Marca un chunk como contado; se llama dentro de begin_chunk
+    void mark_done(size_t chunk_id, size_t bytes) {
+        if (!checkpoint) return;
+        lock_guard<std::mutex> lock(done_mutex);
+        done_chunks.insert(chunk_id);
+        done_bytes += bytes;
+    }
+
+    CountTable& table(size_t worker_id) {
+        return worker_counts[worker_id];
+    }
+
+    HyperLogLog& distinct(size_t worker_id) {
+        return worker_distinct[worker_id];
+    }
+
+    // Palabras unicas estimadas de toda la entrada leida hasta ahora, tambien
+    // despues de los spills. No toma ningun lock.
+    uint64_t estimate_unique_words() const {
+        HyperLogLog merged;
+        for (const auto& distinct : worker_distinct) {
+            merged.merge(distinct);
+        }
+        return merged.estimate();
+    }
+
+    // Bloqueo compartido que protege el procesamiento de un chunk. Si hay un spill
+    // esperando, los hilos no empiezan chunks nuevos para que no espere indefinidamente.
+    shared_lock<shared_mutex> begin_chunk() {
+        {
+            unique_lock<std::mutex> lock(spill_mutex);
+            spill_done.wait(lock, [this] { return pending_spills == 0; });
+        }
+        return shared_lock<shared_mutex>(epoch_mutex);
+    }
+
+    void add_words(uint64_t count) {
+        total_words.fetch_add(count, memory_order_relaxed);
+    }
+
+    // Informa al presupuesto la memoria actual de un hilo. Se llama dentro de
+    // begin_chunk para que no se cruce con un spill que vacia las tablas.
+    void report_memory(size_t worker_id, size_t bytes) {
+        budget.add(MemoryBudget::TABLES, static_cast<int64_t>(bytes) - static_cast<int64_t>(reported_bytes[worker_id]));
+        reported_bytes[worker_id] = bytes;
+        budget.set(MemoryBudget::DICTIONARY, dictionary.memory_bytes());
+    }
+
+    bool over_limit(size_t word_limit) const {
+        return dictionary.size() > word_limit || (dictionary.size() > 0 && budget.data_over_budget());
+    }
+
+    // Si las tablas y el diccionario superan el presupuesto (o el limite opcional de
+    // palabras unicas), suma las tablas de todos los hilos, las vuelca al archivo
+    // temporal y vacia tablas y diccionario. Con checkpoints tambien se vuelca cuando
+    // toca uno, y cada spill termina con un checkpoint.
+    void spill_if_needed(size_t word_limit, const string& temp_file) {
+        if (!over_limit(word_limit) && !checkpoint_due()) return;
+
+        start_spill();
+        unique_lock<shared_mutex> lock(epoch_mutex);
+        if (over_limit(word_limit) || checkpoint_due()) {
+            bool spilled = true;
+            try {
+                write_spill(temp_file);
+            } catch (const exception& e) {
+                cerr << e.what() << endl;
+                spilled = false;
+            }
+            // Si el spill fallo el checkpoint anterior sigue siendo el ultimo valido
+            if (checkpoint && spilled) {
+                try {
+                    save_checkpoint(temp_file);
+                } catch (const exception& e) {
+                    cerr << "\nFailed to write checkpoint: " << e.what() << endl;
+                }
+            }
+            clear_tables();
+        }
+        lock.unlock();
+        finish_spill();
+    }
+
+    // Vuelca todo lo que queda en memoria al archivo temporal. A diferencia de
+    // spill_if_needed un error se propaga: se usa al final del map distribuido,
+    // cuando el archivo temporal es lo unico que se envia a los reducers.
+    void spill_all(const string& temp_file) {
+        start_spill();
+        try {
+            unique_lock<shared_mutex> lock(epoch_mutex);
+            if (dictionary.size() > 0) write_spill(temp_file);
+            clear_tables();
+        } catch (...) {
+            finish_spill();
+            throw;
         }
+        finish_spill();
     }
 
-    void write_to_file(const string& filename) {
-        ofstream file(filename);
+    // Reduccion final: cada hilo suma un rango contiguo de ids de todas las tablas,
+    // sin memoria compartida entre ellos
+    void reduce() {
+        size_t num_terms = dictionary.size();
+        totals.assign(num_terms, 0);
+
+        vector<thread> reducers;
+        for (size_t p = 0; p < num_workers; ++p) {
+            size_t begin = num_terms * p / num_workers;
+            size_t end = num_terms * (p + 1) / num_workers;
+            reducers.emplace_back([this, begin, end]() {
+                for (const auto& counts : worker_counts) {
+                    size_t limit = min(end, counts.size());
+                    for (size_t id = begin; id < limit; ++id) {
+                        totals[id] += counts[id];
+                    }
+                }
+            });
+        }
+        for (auto& reducer : reducers) {
+            reducer.join();
+        }
+
+        for (auto& counts : worker_counts) {
+            CountTable().swap(counts);
+        }
+    }
+
+    void merge_from_file(const string& temp_file) {
+        ifstream file(temp_file);
         if (!file.is_open()) {
-            cerr << "Failed to open output file: " << filename << endl;
+            cerr << "Failed to open temp file: " << temp_file << endl;
             return;
         }
+        string word;
+        uint64_t count;
+        while (file >> word >> count) {
+            uint32_t id = dictionary.intern(word);
+            if (id >= totals.size()) totals.resize(id + 1, 0);
+            totals[id] += count;
+        }
+    }
+
+    // Escribe "palabra conteo" por linea en el orden pedido. Con partitions > 1 cada
+    // termino va al archivo de su particion (ver partition_of), que conserva el orden,
+    // y las particiones se escriben en paralelo. En el modo distribuido cada reducer
+    // escribe solo sus particiones: las p con p % owners == owner.
+    void write_to_file(const string& filename, OutputOrder order, size_t partitions,
+        size_t owner = 0, size_t owners = 1) {
+        vector<uint32_t> ids;
+        ids.reserve(totals.size());
+        for (uint32_t id = 0; id < totals.size(); ++id) {
+            if (totals[id] > 0) ids.push_back(id);
+        }
 
-        for (const auto& [word, docs] : index) {
-            file << word;
-            for (const auto& doc : docs) {
-                file << " " << doc;
+        if (order == OutputOrder::TERM) {
+            parallel_sort(ids.begin(), ids.end(), [this](uint32_t a, uint32_t b) {
+                return dictionary.term(a) < dictionary.term(b);
+            }, num_workers);
+        } else if (order == OutputOrder::COUNT) {
+            parallel_sort(ids.begin(), ids.end(), [this](uint32_t a, uint32_t b) {
+                return totals[a] != totals[b] ? totals[a] > totals[b] : dictionary.term(a) < dictionary.term(b);
+            }, num_workers);
+        }
+
+        if (partitions <= 1) {
+            BufferedWriter file(filename);
+            for (uint32_t id : ids) {
+                write_count_line(file, dictionary.term(id), totals[id]);
             }
-            file << "\n";
+            file.close();
+            return;
         }
 
-        file.close();
+        vector<vector<uint32_t>> parts(partitions);
+        for (uint32_t id : ids) {
+            parts[partition_of(dictionary.term(id), partitions)].push_back(id);
+        }
+        vector<uint32_t>().swap(ids);
+
+        vector<size_t> owned;
+        for (size_t p = owner; p < partitions; p += owners) {
+            owned.push_back(p);
+        }
+
+        atomic<size_t> next_part(0);
+        exception_ptr write_error;
+        std::mutex error_mutex;
+        vector<thread> writers;
+        for (size_t w = 0; w < min(num_workers, owned.size()); ++w) {
+            writers.emplace_back([&]() {
+                try {
+                    size_t i;
+                    while ((i = next_part.fetch_add(1)) < owned.size()) {
+                        size_t p = owned[i];
+                        BufferedWriter file(partition_path(filename, p));
+                        for (uint32_t id : parts[p]) {
+                            write_count_line(file, dictionary.term(id), totals[id]);
+                        }
+                        file.close();
+                    }
+                } catch (...) {
+                    lock_guard<std::mutex> lock(error_mutex);
+                    if (!write_error) write_error = current_exception();
+                }
+            });
+        }
+        for (auto& writer : writers) {
+            writer.join();
+        }
+        if (write_error) rethrow_exception(write_error);
+    }
+
+    uint64_t get_total_words() const {
+        return total_words.load(memory_order_relaxed);
     }
 
-    size_t get_total_words() const {
-        return index.size();
+    size_t get_unique_words() const {
+        return count_if(totals.begin(), totals.end(), [](uint64_t count) { return count > 0; });
     }
 };
-    
 
-void process_chunk(ThreadSafeQueue& queue, GlobalInvertedIndex& global_index, 
-    atomic<bool>& stop_flag) {
-    pair<string, size_t> item;
-    
+
+// node_counters solo con --numa: los del nodo del hilo
+void process_chunk(ChunkQueue& queue, GlobalWordCount& global_counts, MemoryBudget& budget,
+    size_t worker_id, const string& temp_file, size_t word_limit, atomic<bool>& stop_flag,
+    atomic<size_t>& progress_bytes, unsigned normalize, NodeCounters* node_counters) {
+    Chunk item;
+    Tokenizer tokenizer(normalize);
+    TermCache terms(global_counts.get_dictionary());
+    CountTable& counts = global_counts.table(worker_id);
+    HyperLogLog& distinct = global_counts.distinct(worker_id);
+
     while (!stop_flag && queue.pop(item)) {
-        const string& chunk = item.first;
-        string doc_id = "doc_" + to_string(item.second); // Usa esto como ID
-        unordered_map<string, unordered_set<string>> local_index;
-        istringstream stream(chunk);
-        string word;
-        while (stream >> word) {
-            size_t start = 0, end = word.size();
-            while (start < end && ispunct(static_cast<unsigned char>(word[start]))) ++start;
-            
-            while (end > start && ispunct(static_cast<unsigned char>(word[end - 1]))) --end;
-            if (start < end) {
-                string clean_word = word.substr(start, end - start);
-                transform(clean_word.begin(), clean_word.end(), clean_word.begin(), ::tolower);
-                local_index[clean_word].insert(doc_id);
+        string_view chunk = item.text();
+        uint64_t chunk_words = 0;
+        {
+            auto epoch = global_counts.begin_chunk();
+            terms.sync();
+            tokenizer.tokenize(chunk, [&](string_view word) {
+                uint32_t id = terms.lookup(word);
+                if (id >= counts.size()) {
+                    counts.resize(max<size_t>(id + 1, counts.size() * 2), 0);
+                }
+                // Solo la primera vez que el hilo ve la palabra (desde el ultimo spill)
+                if (counts[id]++ == 0) distinct.add(word);
+                chunk_words++;
+            });
+            global_counts.report_memory(worker_id, counts.capacity() * sizeof(uint64_t) + terms.memory_bytes());
+            global_counts.add_words(chunk_words);
+            global_counts.mark_done(item.id, chunk.size());
+        }
+        if (node_counters) node_counters->record(chunk, chunk_words);
+
+        progress_bytes.fetch_add(chunk.size());
+        budget.release_queue(item.accounted);
+        item = Chunk();
+
+        // Si las estructuras en memoria superan el presupuesto se vuelcan a disco
+        global_counts.spill_if_needed(word_limit, temp_file);
+    }
+}
+
+// Modo --top-k: cada hilo alimenta su propio sketch Space-Saving en lugar del
+// diccionario y las tablas, asi que la memoria no depende del vocabulario
+void process_chunk_top_k(ChunkQueue& queue, SpaceSaving& sketch, GlobalWordCount& global_counts,
+    MemoryBudget& budget, size_t worker_id, atomic<bool>& stop_flag, atomic<size_t>& progress_bytes,
+    unsigned normalize, NodeCounters* node_counters) {
+    Chunk item;
+    Tokenizer tokenizer(normalize);
+    HyperLogLog& distinct = global_counts.distinct(worker_id);
+    size_t reported = 0;
+
+    while (!stop_flag && queue.pop(item)) {
+        string_view chunk = item.text();
+        uint64_t chunk_words = 0;
+        tokenizer.tokenize(chunk, [&](string_view word) {
+            // Una palabra que vuelve al sketch ya esta en el HyperLogLog, pero
+            // anadirla otra vez no cambia la estimacion
+            if (sketch.add(word)) distinct.add(word);
+            chunk_words++;
+        });
+
+        size_t bytes = sketch.memory_bytes();
+        budget.add(MemoryBudget::TABLES, static_cast<int64_t>(bytes) - static_cast<int64_t>(reported));
+        reported = bytes;
+
+        global_counts.add_words(chunk_words);
+        if (node_counters) node_counters->record(chunk, chunk_words);
+        progress_bytes.fetch_add(chunk.size());
+        budget.release_queue(item.accounted);
+        item = Chunk();
+    }
+}
+
+// Segunda pasada opcional de --top-k: vuelve a leer la entrada y cuenta de forma
+// exacta solo las palabras candidatas del sketch
+vector<uint64_t> count_candidates(const string& input_file, Compression compression, size_t chunk_size,
+    size_t num_threads, size_t decode_threads, unsigned normalize, const vector<SpaceSaving::Counter>& candidates) {
+    unordered_map<string_view, uint32_t> index;
+    index.reserve(candidates.size());
+    for (uint32_t i = 0; i < candidates.size(); ++i) {
+        index.emplace(candidates[i].term, i);
+    }
+
+    ChunkQueue queue(2 * num_threads);
+    vector<vector<uint64_t>> counts(num_threads, vector<uint64_t>(candidates.size(), 0));
+    vector<thread> workers;
+    for (size_t i = 0; i < num_threads; ++i) {
+        workers.emplace_back([&, i]() {
+            Chunk item;
+            Tokenizer tokenizer(normalize);
+            while (queue.pop(item)) {
+                tokenizer.tokenize(item.text(), [&](string_view word) {
+                    auto it = index.find(word);
+                    if (it != index.end()) counts[i][it->second]++;
+                });
+                item = Chunk();
             }
+        });
+    }
+
+    try {
+        size_t chunk_id = 0;
+        if (compression != Compression::NONE) {
+            DecompressingReader decoder(input_file, decode_threads);
+            read_chunks(decoder, chunk_size, [&](string&& text, uint64_t) {
+                Chunk item;
+                item.id = chunk_id++;
+                item.owned = std::move(text);
+                return queue.push(std::move(item));
+            });
+            queue.close();
+            for (auto& worker : workers) worker.join();
+        } else {
+            // La segunda pasada siempre mapea el archivo: no hace falta copiar nada
+            MappedFile mapping(input_file);
+            split_at_whitespace(mapping.view(), chunk_size, [&](string_view slice) {
+                Chunk item;
+                item.id = chunk_id++;
+                item.mapped = slice;
+                queue.push(std::move(item));
+            });
+            queue.close();
+            for (auto& worker : workers) worker.join();
         }
-        
-        global_index.merge(local_index);
+    } catch (...) {
+        queue.close();
+        for (auto& worker : workers) {
+            if (worker.joinable()) worker.join();
+        }
+        throw;
+    }
+
+    vector<uint64_t> totals(candidates.size(), 0);
+    for (const auto& worker_counts : counts) {
+        for (size_t i = 0; i < totals.size(); ++i) totals[i] += worker_counts[i];
+    }
+    return totals;
+}
+
+void write_top_k(const string& filename, const vector<SpaceSaving::Counter>& top) {
+    BufferedWriter file(filename);
+    for (const auto& counter : top) {
+        write_count_line(file, counter.term, counter.count);
     }
+    file.close();
 }
 
 
@@ -155,29 +651,557 @@ string format_number(uint64_t num) {
     return oss.str();
 }
 
+// ---------------------------------------------------------------------------
+// Modo distribuido. El coordinador (--coordinator=ADDR --workers=N) corta la
+// entrada en rangos como --readers y los reparte a los workers (--worker=ADDR) a
+// medida que los piden. Cada worker cuenta sus rangos igual que el modo normal y
+// al terminar vuelca todo a su archivo temporal. Despues manda cada linea al
+// worker duenio de su particion (particion % N) y suma las que le llegan; cada
+// worker escribe sus particiones del resultado. Los workers tienen que ver la
+// entrada y la salida en las mismas rutas (misma maquina o disco compartido).
+// ---------------------------------------------------------------------------
+
+enum class ClusterMessage : uint8_t {
+    HELLO = 1,       // worker -> coordinador: direccion de shuffle
+    JOB,             // coordinador -> worker: numero de worker, opciones y direcciones de todos
+    NEXT_RANGE,      // worker -> coordinador
+    RANGE,           // coordinador -> worker: id, inicio y fin
+    NO_MORE_RANGES,
+    MAP_DONE,        // worker -> coordinador: palabras contadas
+    COUNTS,          // worker -> worker: lote de lineas "palabra conteo"
+    COUNTS_END,
+    REDUCE_DONE,     // worker -> coordinador: palabras y terminos de sus particiones
+    FAILED           // worker -> coordinador: mensaje de error
+};
+
+// Bytes de un lote de shuffle antes de enviarlo
+constexpr size_t SHUFFLE_BATCH = 1 << 20;
+
+void send_cluster(Socket& socket, ClusterMessage type, const vector<string>& fields = {}) {
+    socket.send_message(static_cast<uint8_t>(type), encode_fields(fields));
+}
+
+// Siguiente mensaje de control. Una conexion cerrada o un FAILED son errores.
+ClusterMessage expect_cluster(Socket& socket, const string& peer, vector<string>& fields) {
+    uint8_t type;
+    string body;
+    if (!socket.recv_message(type, body)) {
+        throw runtime_error(peer + " closed the connection");
+    }
+    fields = decode_fields(body);
+    if (static_cast<ClusterMessage>(type) == ClusterMessage::FAILED) {
+        throw runtime_error(peer + " failed: " + body);
+    }
+    return static_cast<ClusterMessage>(type);
+}
+
+// Reduce distribuido: suma los lotes "palabra conteo" que manda un worker para
+// las particiones de este proceso. Cada conexion usa la tabla de un hilo del
+// GlobalWordCount del reducer, asi que el presupuesto y los spills son los mismos
+// que al contar chunks.
+void receive_counts(Socket& peer, GlobalWordCount& reducer, size_t slot, const string& temp_file, size_t word_limit) {
+    TermCache terms(reducer.get_dictionary());
+    CountTable& counts = reducer.table(slot);
+    HyperLogLog& distinct = reducer.distinct(slot);
+    uint8_t type;
+    string batch;
+
+    while (true) {
+        if (!peer.recv_message(type, batch)) {
+            throw runtime_error("Worker closed its shuffle connection before the end");
+        }
+        if (static_cast<ClusterMessage>(type) == ClusterMessage::COUNTS_END) break;
+        if (static_cast<ClusterMessage>(type) != ClusterMessage::COUNTS) {
+            throw runtime_error("Unexpected message in shuffle connection");
+        }
+        uint64_t batch_words = 0;
+        {
+            auto epoch = reducer.begin_chunk();
+            terms.sync();
+            size_t start = 0;
+            while (start < batch.size()) {
+                size_t end = batch.find('\n', start);
+                if (end == string::npos) end = batch.size();
+                string_view line(batch.data() + start, end - start);
+                start = end + 1;
+                size_t space = line.rfind(' ');
+                uint64_t count = 0;
+                if (space == string_view::npos ||
+                    from_chars(line.data() + space + 1, line.data() + line.size(), count).ec != errc()) {
+                    throw runtime_error("Malformed shuffle line: " + string(line));
+                }
+                string_view word = line.substr(0, space);
+                uint32_t id = terms.lookup(word);
+                if (id >= counts.size()) {
+                    counts.resize(max<size_t>(id + 1, counts.size() * 2), 0);
+                }
+                if (counts[id] == 0) distinct.add(word);
+                counts[id] += count;
+                batch_words += count;
+            }
+            reducer.report_memory(slot, counts.capacity() * sizeof(uint64_t) + terms.memory_bytes());
+            reducer.add_words(batch_words);
+        }
+        reducer.spill_if_needed(word_limit, temp_file);
+    }
+}
+
+// Resumen de --numa: lo que proceso cada nodo y cuantos chunks leyo de memoria de otro nodo
+void print_node_counters(const NumaTopology& topology, const vector<NodeCounters>& counters, size_t num_threads,
+    size_t unpinned_threads) {
+    for (size_t n = 0; n < counters.size(); ++n) {
+        size_t threads = 0;
+        for (size_t i = 0; i < num_threads; ++i) {
+            if (topology.node_of_thread(i, num_threads) == n) threads++;
+        }
+        cout << "NUMA node " << counters[n].node_id << ": " << threads << " threads, "
+             << counters[n].chunks << " chunks (" << format_bytes(counters[n].bytes) << "), "
+             << counters[n].words << " words, " << counters[n].remote_chunks << " remote chunks" << endl;
+    }
+    if (unpinned_threads > 0) {
+        cout << "NUMA: " << unpinned_threads << " threads could not be pinned (restricted CPU affinity?)" << endl;
+    }
+}
+
+int run_worker(const CommandLine& args) {
+    size_t num_threads = stoul(args.get("threads", to_string(thread::hardware_concurrency())));
+    if (num_threads == 0) num_threads = 4;
+    size_t memory_budget = parse_byte_size(args.get("memory-budget", "4G"));
+    size_t queue_chunks = stoul(args.get("queue-chunks", to_string(2 * num_threads)));
+
+    Socket coordinator;
+    string map_temp;
+    string reduce_temp;
+    try {
+        SocketAddress coordinator_address = SocketAddress::parse(args.get("worker"));
+        coordinator = connect_socket(coordinator_address, chrono::seconds(60));
+
+        // Los demas workers se conectan a esta direccion para el shuffle. Por defecto
+        // es un socket unix junto al del coordinador o un puerto libre en la IP con la
+        // que se llego al coordinador.
+        SocketAddress listen_address;
+        if (args.has("listen")) {
+            listen_address = SocketAddress::parse(args.get("listen"));
+        } else if (coordinator_address.is_unix) {
+            listen_address = SocketAddress::parse("unix:" + coordinator_address.path + "." + to_string(::getpid()));
+        } else {
+            listen_address = SocketAddress::parse("tcp:0.0.0.0:0");
+        }
+        Listener shuffle(listen_address);
+        SocketAddress advertised = shuffle.address();
+        if (!advertised.is_unix && (advertised.host == "0.0.0.0" || advertised.host == "::")) {
+            advertised.host = coordinator.local_host();
+        }
+        send_cluster(coordinator, ClusterMessage::HELLO, {advertised.to_string()});
+
+        vector<string> job;
+        if (expect_cluster(coordinator, "Coordinator", job) != ClusterMessage::JOB || job.size() < 10) {
+            throw runtime_error("Unexpected message from coordinator");
+        }
+        size_t rank = stoul(job[0]);
+        size_t num_workers = stoul(job[1]);
+        string input_file = job[2];
+        uint64_t file_size = stoull(job[3]);
+        string output_file = job[4];
+        size_t word_limit = stoull(job[5]);
+        unsigned normalize = static_cast<unsigned>(stoul(job[6]));
+        size_t partitions = stoul(job[7]);
+        OutputOrder output_order = parse_output_order(job[8]);
+        vector<string> peers(job.begin() + 9, job.end());
+        if (peers.size() != num_workers) throw runtime_error("Coordinator sent " + to_string(peers.size()) + " worker addresses");
+
+        map_temp = output_file + ".worker-" + to_string(rank) + ".temp";
+        reduce_temp = output_file + ".reduce-" + to_string(rank) + ".temp";
+        if (filesystem::exists(map_temp)) filesystem::remove(map_temp);
+        if (filesystem::exists(reduce_temp)) filesystem::remove(reduce_temp);
+
+        cout << "Worker " << rank << " of " << num_workers << ": " << input_file << " with " << num_threads
+             << " threads, shuffle on " << advertised.to_string() << endl;
+
+        // Las conexiones de shuffle (tambien la de cada worker consigo mismo) se abren
+        // antes de contar: si un worker muere despues, los demas lo ven como una
+        // conexion cerrada en lugar de esperarlo para siempre
+        vector<Socket> outgoing(num_workers);
+        for (size_t w = 0; w < num_workers; ++w) {
+            outgoing[w] = connect_socket(SocketAddress::parse(peers[w]), chrono::seconds(60));
+        }
+        vector<Socket> incoming(num_workers);
+        for (size_t w = 0; w < num_workers; ++w) {
+            incoming[w] = shuffle.accept(&coordinator);
+        }
+
+        // Map: los rangos se piden de uno en uno, asi los workers rapidos leen mas
+        uint64_t map_words = 0;
+        {
+            ChunkQueue chunk_queue(queue_chunks);
+            MemoryBudget budget(memory_budget);
+            GlobalWordCount global_counts(num_threads, budget);
+            atomic<bool> stop_flag(false);
+            atomic<size_t> progress_bytes(0);
+            vector<thread> threads;
+            for (size_t i = 0; i < num_threads; ++i) {
+                threads.emplace_back(process_chunk, ref(chunk_queue), ref(global_counts), ref(budget), i,
+                                     cref(map_temp), word_limit, ref(stop_flag), ref(progress_bytes), normalize, nullptr);
+            }
+            try {
+                RangeReader reader(input_file);
+                if (reader.size() != file_size) {
+                    throw runtime_error("Input file " + input_file + " has a different size than on the coordinator");
+                }
+                vector<string> fields;
+                while (true) {
+                    send_cluster(coordinator, ClusterMessage::NEXT_RANGE);
+                    ClusterMessage type = expect_cluster(coordinator, "Coordinator", fields);
+                    if (type == ClusterMessage::NO_MORE_RANGES) break;
+                    if (type != ClusterMessage::RANGE || fields.size() != 3) {
+                        throw runtime_error("Unexpected message from coordinator");
+                    }
+                    ByteRange range{stoull(fields[1]), stoull(fields[2])};
+                    if (!budget.acquire_queue(range.size(), stop_flag)) break;
+                    Chunk item;
+                    item.id = stoull(fields[0]);
+                    item.accounted = range.size();
+                    reader.read(range, item.owned);
+                    chunk_queue.push(std::move(item));
+                }
+                chunk_queue.close();
+                for (auto& thread : threads) {
+                    thread.join();
+                }
+            } catch (...) {
+                stop_flag = true;
+                chunk_queue.close();
+                for (auto& thread : threads) {
+                    if (thread.joinable()) thread.join();
+                }
+                throw;
+            }
+            // Todo lo contado pasa al archivo temporal y la memoria queda para el reduce
+            global_counts.spill_all(map_temp);
+            map_words = global_counts.get_total_words();
+        }
+        send_cluster(coordinator, ClusterMessage::MAP_DONE, {to_string(map_words)});
+        cout << "Map done: " << map_words << " words, shuffling..." << endl;
+
+        // Shuffle y reduce a la vez: un hilo reparte el archivo temporal entre los
+        // reducers y un hilo por conexion entrante suma lo que llega
+        MemoryBudget reduce_budget(memory_budget);
+        GlobalWordCount reducer(num_workers, reduce_budget);
+        exception_ptr shuffle_error;
+        std::mutex error_mutex;
+        auto fail = [&]() {
+            lock_guard<std::mutex> lock(error_mutex);
+            if (!shuffle_error) shuffle_error = current_exception();
+            // Despierta a los demas hilos para no esperar a workers que siguen vivos
+            for (auto& socket : outgoing) socket.shutdown();
+            for (auto& socket : incoming) socket.shutdown();
+        };
+
+        vector<thread> receivers;
+        for (size_t w = 0; w < num_workers; ++w) {
+            receivers.emplace_back([&, w]() {
+                try {
+                    receive_counts(incoming[w], reducer, w, reduce_temp, word_limit);
+                } catch (...) {
+                    fail();
+                }
+            });
+        }
+        try {
+            vector<string> batches(num_workers);
+            ifstream file(map_temp);
+            if (!file.is_open() && filesystem::exists(map_temp)) {
+                throw runtime_error("Failed to open temp file: " + map_temp);
+            }
+            string word;
+            uint64_t count;
+            while (file >> word >> count) {
+                size_t owner = partition_of(word, partitions) % num_workers;
+                string& batch = batches[owner];
+                batch += word;
+                batch += ' ';
+                batch += to_string(count);
+                batch += '\n';
+                if (batch.size() >= SHUFFLE_BATCH) {
+                    outgoing[owner].send_message(static_cast<uint8_t>(ClusterMessage::COUNTS), batch);
+                    batch.clear();
+                }
+            }
+            for (size_t w = 0; w < num_workers; ++w) {
+                if (!batches[w].empty()) {
+                    outgoing[w].send_message(static_cast<uint8_t>(ClusterMessage::COUNTS), batches[w]);
+                }
+                send_cluster(outgoing[w], ClusterMessage::COUNTS_END);
+            }
+        } catch (...) {
+            fail();
+        }
+        for (auto& receiver : receivers) {
+            receiver.join();
+        }
+        if (shuffle_error) rethrow_exception(shuffle_error);
+
+        reducer.reduce();
+        if (filesystem::exists(reduce_temp)) reducer.merge_from_file(reduce_temp);
+        reducer.write_to_file(output_file, output_order, partitions, rank, num_workers);
+        filesystem::remove(map_temp);
+        if (filesystem::exists(reduce_temp)) filesystem::remove(reduce_temp);
+
+        send_cluster(coordinator, ClusterMessage::REDUCE_DONE,
+                     {to_string(reducer.get_total_words()), to_string(reducer.get_unique_words())});
+        cout << "Reduce done: " << reducer.get_total_words() << " words, "
+             << reducer.get_unique_words() << " unique in this worker's partitions" << endl;
+        return 0;
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        if (coordinator.is_open()) {
+            try {
+                send_cluster(coordinator, ClusterMessage::FAILED, {e.what()});
+            } catch (const exception&) {
+                // El coordinador ya no esta; no hay a quien avisar
+            }
+        }
+        if (!map_temp.empty() && filesystem::exists(map_temp)) filesystem::remove(map_temp);
+        if (!reduce_temp.empty() && filesystem::exists(reduce_temp)) filesystem::remove(reduce_temp);
+        return 1;
+    }
+}
+
+int run_coordinator(const CommandLine& args) {
+    string input_file = args.positional[0];
+    string output_file = args.positional[1];
+    size_t chunk_size_mb = (args.positional.size() > 2) ? stoul(args.positional[2]) : 100;
+    size_t chunk_size = chunk_size_mb * 1024 * 1024;
+    // Los hilos los elige cada worker (--threads); el limite de palabras se le pasa
+    size_t word_limit = (args.positional.size() > 4) ? stoul(args.positional[4]) : SIZE_MAX;
+    size_t num_workers = max<size_t>(1, stoul(args.get("workers", "1")));
+    // Al menos una particion por worker para que todos reduzcan algo
+    size_t partitions = max<size_t>(num_workers, stoul(args.get("partitions", to_string(num_workers))));
+    unsigned normalize = parse_normalize_mode(args.get("normalize"));
+    string sort_name = args.get("sort");
+
+    if (args.has("top-k") || args.has("checkpoint-interval") || args.has("resume")) {
+        cerr << "--top-k, --checkpoint-interval and --resume are not supported with --coordinator" << endl;
+        return 1;
+    }
+    if (!std::filesystem::exists(input_file)) {
+        cerr << "Input file does not exist: " << input_file << endl;
+        return 1;
+    }
+    // Un archivo comprimido no se puede cortar en rangos independientes
+    if (detect_compression_file(input_file) != Compression::NONE) {
+        cerr << "Compressed input is not supported with --coordinator" << endl;
+        return 1;
+    }
+
+    vector<Socket> workers(num_workers);
+    try {
+        parse_output_order(sort_name);
+        RangeReader reader(input_file);
+        vector<ByteRange> ranges = reader.split(chunk_size);
+        uint64_t file_size = reader.size();
+
+        Listener listener(SocketAddress::parse(args.get("coordinator")));
+        cout << "Processing file: " << input_file << endl;
+        cout << "File size: " << format_bytes(file_size) << " (" << ranges.size() << " ranges of "
+             << format_bytes(chunk_size) << ")" << endl;
+        cout << "Partitions: " << partitions << " over " << num_workers << " workers" << endl;
+        cout << "Waiting for " << num_workers << " workers on " << listener.address().to_string() << "..." << endl;
+
+        vector<string> peers(num_workers);
+        for (size_t w = 0; w < num_workers; ++w) {
+            workers[w] = listener.accept();
+            vector<string> fields;
+            if (expect_cluster(workers[w], "Worker " + to_string(w), fields) != ClusterMessage::HELLO) {
+                throw runtime_error("Unexpected message from worker " + to_string(w));
+            }
+            peers[w] = fields.at(0);
+            cout << "Worker " << w << " connected (shuffle on " << peers[w] << ")" << endl;
+        }
+        for (size_t w = 0; w < num_workers; ++w) {
+            vector<string> job = {to_string(w), to_string(num_workers), input_file, to_string(file_size),
+                                  output_file, to_string(word_limit), to_string(normalize),
+                                  to_string(partitions), sort_name};
+            job.insert(job.end(), peers.begin(), peers.end());
+            send_cluster(workers[w], ClusterMessage::JOB, job);
+        }
+
+        auto start_time = chrono::high_resolution_clock::now();
+        atomic<size_t> next_range(0);
+        atomic<uint64_t> dispatched_bytes(0);
+        atomic<uint64_t> map_words(0);
+        atomic<uint64_t> reduce_words(0);
+        atomic<uint64_t> unique_words(0);
+        atomic<size_t> maps_done(0);
+        atomic<bool> finished(false);
+        exception_ptr worker_error;
+        std::mutex error_mutex;
+
+        vector<thread> servers;
+        for (size_t w = 0; w < num_workers; ++w) {
+            servers.emplace_back([&, w]() {
+                try {
+                    string peer = "Worker " + to_string(w);
+                    vector<string> fields;
+                    while (true) {
+                        ClusterMessage type = expect_cluster(workers[w], peer, fields);
+                        if (type == ClusterMessage::NEXT_RANGE) {
+                            size_t i = next_range.fetch_add(1);
+                            if (i < ranges.size()) {
+                                dispatched_bytes.fetch_add(ranges[i].size());
+                                send_cluster(workers[w], ClusterMessage::RANGE,
+                                             {to_string(i), to_string(ranges[i].begin), to_string(ranges[i].end)});
+                            } else {
+                                send_cluster(workers[w], ClusterMessage::NO_MORE_RANGES);
+                            }
+                        } else if (type == ClusterMessage::MAP_DONE) {
+                            map_words.fetch_add(stoull(fields.at(0)));
+                            maps_done.fetch_add(1);
+                        } else if (type == ClusterMessage::REDUCE_DONE) {
+                            reduce_words.fetch_add(stoull(fields.at(0)));
+                            unique_words.fetch_add(stoull(fields.at(1)));
+                            return;
+                        } else {
+                            throw runtime_error("Unexpected message from " + peer);
+                        }
+                    }
+                } catch (...) {
+                    lock_guard<std::mutex> lock(error_mutex);
+                    if (!worker_error) worker_error = current_exception();
+                    // Los demas workers ven el coordinador cerrado y terminan con error
+                    for (auto& worker : workers) worker.shutdown();
+                }
+            });
+        }
+
+        thread progress_thread([&]() {
+            while (!finished) {
+                auto elapsed = chrono::duration_cast<chrono::seconds>(
+                    chrono::high_resolution_clock::now() - start_time).count();
+                if (elapsed > 0) {
+                    double percentage = static_cast<double>(dispatched_bytes) / max<uint64_t>(1, file_size) * 100.0;
+                    cout << "\rProgress: " << fixed << setprecision(2) << percentage << "% dispatched "
+                         << "(" << format_bytes(dispatched_bytes) << " / " << format_bytes(file_size) << ") - "
+                         << "Maps done: " << maps_done << "/" << num_workers << " - "
+                         << "Time: " << elapsed << "s" << flush;
+                }
+                this_thread::sleep_for(chrono::seconds(1));
+            }
+        });
+
+        for (auto& server : servers) {
+            server.join();
+        }
+        finished = true;
+        progress_thread.join();
+        if (worker_error) rethrow_exception(worker_error);
+        // Cada palabra contada en un map tiene que llegar a exactamente un reducer
+        if (reduce_words != map_words) {
+            throw runtime_error("Reducers received " + to_string(reduce_words.load()) + " words but maps counted " +
+                                to_string(map_words.load()));
+        }
+
+        auto end_time = chrono::high_resolution_clock::now();
+        auto duration = chrono::duration_cast<chrono::seconds>(end_time - start_time).count();
+
+        cout << "\nProcessing complete!" << endl;
+        cout << "Output: " << (partitions > 1 ? partition_path(output_file, 0) + " ... " +
+                                                partition_path(output_file, partitions - 1) : output_file) << endl;
+        cout << "Total words: " << map_words << endl;
+        cout << "Unique words: " << unique_words << endl;
+        cout << "Total time: " << duration << " seconds" << endl;
+        return 0;
+    } catch (const exception& e) {
+        cerr << "\nError: " << e.what() << endl;
+        return 1;
+    }
+}
+
 int main(int argc, char* argv[]) {
-    if (argc < 3) {
-        cerr << "Usage: " << argv[0] << " <input_file> <output_file> [chunk_size_MB] [num_threads] [memory_limit]" << endl;
+    CommandLine args(argc, argv);
+    // Un worker recibe la entrada, la salida y las opciones del coordinador
+    if (args.has("worker")) return run_worker(args);
+    if (args.positional.size() < 2) {
+        cerr << "Usage: " << argv[0] << " <input_file> <output_file> [chunk_size_MB] [num_threads] [max_unique_words] [--mmap] [--normalize=MODE] [--memory-budget=SIZE] [--queue-chunks=N] [--readers=N] [--async-io[=uring|threads]] [--io-depth=N] [--direct] [--decode-threads=N] [--top-k=N] [--sketch-size=N] [--top-k-exact] [--sort=term|count] [--partitions=N] [--checkpoint-interval=SECONDS] [--resume] [--numa[=nodes|cores]] [--coordinator=ADDR --workers=N]" << endl;
+        cerr << "       " << argv[0] << " --worker=ADDR [--threads=N] [--memory-budget=SIZE] [--queue-chunks=N] [--listen=ADDR]" << endl;
         return 1;
     }
+    if (args.has("coordinator")) return run_coordinator(args);
     
-    string input_file = argv[1];
-    string output_file = argv[2];
+    string input_file = args.positional[0];
+    string output_file = args.positional[1];
     
     // Default values
-    size_t chunk_size_mb = (argc > 3) ? stoul(argv[3]) : 100; // Default 100MB
+    size_t chunk_size_mb = (args.positional.size() > 2) ? stoul(args.positional[2]) : 100; // Default 100MB
     size_t chunk_size = chunk_size_mb * 1024 * 1024;
     
-    size_t num_threads = (argc > 4) ? stoul(argv[4]) : thread::hardware_concurrency();
+    size_t num_threads = (args.positional.size() > 3) ? stoul(args.positional[3]) : thread::hardware_concurrency();
     if (num_threads == 0) num_threads = 4; // Fallback if hardware_concurrency returns 0
     
-    size_t memory_limit = (argc > 5) ? stoul(argv[5]) : 1000000; // Default 1M unique words
+    // Limite opcional de palabras unicas; por defecto decide solo el presupuesto en bytes
+    size_t word_limit = (args.positional.size() > 4) ? stoul(args.positional[4]) : SIZE_MAX;
+    // Un archivo comprimido (detectado por sus bytes magicos) siempre se lee en streaming
+    Compression compression = detect_compression_file(input_file);
+    size_t decode_threads = stoul(args.get("decode-threads", to_string(max<size_t>(1, num_threads / 2))));
+    bool use_mmap = args.has("mmap") && compression == Compression::NONE;
+    unsigned normalize = parse_normalize_mode(args.get("normalize"));
+    size_t memory_budget = parse_byte_size(args.get("memory-budget", "4G"));
+    // Chunks que pueden esperar en la cola; el presupuesto limita ademas sus bytes
+    size_t queue_chunks = stoul(args.get("queue-chunks", to_string(2 * num_threads)));
+    // Con mas de un lector el archivo se corta en rangos y cada lector los lee con pread
+    size_t num_readers = use_mmap || compression != Compression::NONE ? 1 : max<size_t>(1, stoul(args.get("readers", "1")));
+    // Lectura asincrona con varias lecturas en vuelo (solo con un lector y sin --mmap)
+    bool async_io = args.has("async-io") && !use_mmap && num_readers == 1 && compression == Compression::NONE;
+    size_t io_depth = max<size_t>(1, stoul(args.get("io-depth", "2")));
+    bool direct_io = args.has("direct");
+    // --numa[=nodes|cores]: hilos fijados a las CPUs de su nodo (o a un nucleo) y una
+    // cola por nodo. Si el archivo se lee con pread hay al menos un lector por nodo
+    // y cada uno lee en memoria de su nodo para los hilos de ese nodo.
+    bool numa = args.has("numa");
+    string numa_mode = args.get("numa").empty() ? "nodes" : args.get("numa");
+    if (numa && numa_mode != "nodes" && numa_mode != "cores") {
+        cerr << "Unknown NUMA mode: " << numa_mode << " (expected nodes or cores)" << endl;
+        return 1;
+    }
+    NumaTopology topology = numa ? NumaTopology::detect() : NumaTopology();
+    size_t num_nodes = numa ? topology.used_nodes(num_threads) : 1;
+    bool numa_readers = numa && !use_mmap && !async_io && compression == Compression::NONE;
+    if (numa_readers) num_readers = max(num_readers, num_nodes);
+    bool use_ranges = num_readers > 1 || numa_readers;
+    // Solo las top_k palabras mas frecuentes, con un sketch de memoria fija por hilo
+    size_t top_k = stoul(args.get("top-k", "0"));
+    size_t sketch_size = max<size_t>(top_k, stoul(args.get("sketch-size", to_string(max<size_t>(1024, 16 * top_k)))));
+    bool top_k_exact = top_k > 0 && args.has("top-k-exact");
+    // Orden del resultado y numero de archivos en que se reparte
+    OutputOrder output_order;
+    try {
+        output_order = parse_output_order(args.get("sort"));
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    size_t partitions = max<size_t>(1, stoul(args.get("partitions", "1")));
+    // Checkpoint cada N segundos (ademas de en cada spill) y reanudacion desde el
+    // ultimo checkpoint completo; con --resume sin intervalo solo hay checkpoints en los spills
+    size_t checkpoint_interval = stoul(args.get("checkpoint-interval", "0"));
+    bool resume = args.has("resume");
+    bool checkpointing = checkpoint_interval > 0 || resume;
+    if (checkpointing && top_k > 0) {
+        cerr << "--checkpoint-interval and --resume are not supported with --top-k" << endl;
+        return 1;
+    }
     
     string temp_file = output_file + ".temp";
+    string checkpoint_file = output_file + ".checkpoint";
     
-    // Remove temp file if it exists
-    if (std::filesystem::exists(temp_file)) {
-        std::filesystem::remove(temp_file);
+    // Remove temp file if it exists (al reanudar contiene los spills del checkpoint)
+    if (!resume) {
+        if (std::filesystem::exists(temp_file)) {
+            std::filesystem::remove(temp_file);
+        }
+        if (std::filesystem::exists(checkpoint_file)) {
+            std::filesystem::remove(checkpoint_file);
+        }
     }
     
     // Check if input file exists and get its size
@@ -188,56 +1212,210 @@ int main(int argc, char* argv[]) {
     
     auto file_size = std::filesystem::file_size(input_file);
     
+    // Los ids de chunk dependen del archivo, de chunk_size y de como se corta la entrada
+    string input_mode = compression != Compression::NONE ? compression_name(compression) :
+                        use_mmap ? "mmap" : use_ranges ? "pread" : async_io ? "async" : "stream";
+    CountCheckpoint checkpoint;
+    checkpoint.path = checkpoint_file;
+    checkpoint.interval = chrono::seconds(checkpoint_interval);
+    checkpoint.fields.set("input", {to_string(file_size),
+        to_string(std::filesystem::last_write_time(input_file).time_since_epoch().count()), input_file});
+    checkpoint.fields.set("options", {to_string(chunk_size), input_mode, to_string(normalize)});
+    
+    // Chunks ya contados en el checkpoint; los lectores los saltan
+    CompletedSet resumed_chunks;
+    uint64_t resumed_words = 0;
+    uint64_t resumed_bytes = 0;
+    bool resumed = false;
+    if (resume && CheckpointFile::exists(checkpoint_file)) {
+        try {
+            CheckpointFile saved;
+            saved.load(checkpoint_file);
+            if (!saved.same(checkpoint.fields, "input") || !saved.same(checkpoint.fields, "options")) {
+                throw runtime_error("Checkpoint " + checkpoint_file + " was written for another input, chunk size or input mode");
+            }
+            // Un spill posterior al checkpoint no cuenta: se recorta el archivo temporal
+            uint64_t spill_bytes = stoull(saved.get("spill", 1)[0]);
+            uint64_t temp_bytes = std::filesystem::exists(temp_file) ? std::filesystem::file_size(temp_file) : 0;
+            if (temp_bytes < spill_bytes) {
+                throw runtime_error("Temp file " + temp_file + " is shorter than its checkpoint");
+            }
+            if (temp_bytes > spill_bytes) std::filesystem::resize_file(temp_file, spill_bytes);
+            auto progress = saved.get("progress", 2);
+            resumed_words = stoull(progress.at(0));
+            resumed_bytes = stoull(progress.at(1));
+            resumed_chunks = CompletedSet::parse(saved.get("done", 1)[0]);
+            resumed = true;
+        } catch (const exception& e) {
+            cerr << "Cannot resume: " << e.what() << endl;
+            return 1;
+        }
+    } else if (resume) {
+        // Sin checkpoint se empieza de cero con un archivo temporal limpio
+        if (std::filesystem::exists(temp_file)) std::filesystem::remove(temp_file);
+    }
+    
     cout << "Processing file: " << input_file << endl;
     cout << "File size: " << format_bytes(file_size) << endl;
     cout << "Chunk size: " << format_bytes(chunk_size) << endl;
     cout << "Using " << num_threads << " threads" << endl;
-    cout << "Memory limit: " << format_number(memory_limit) << " unique words" << endl;
+    cout << "Memory budget: " << format_bytes(memory_budget) << endl;
+    cout << "Queue capacity: " << queue_chunks << " chunks" << endl;
+    if (word_limit != SIZE_MAX) {
+        cout << "Unique word limit: " << format_number(word_limit) << endl;
+    }
+    if (compression != Compression::NONE) {
+        cout << "Input mode: " << compression_name(compression) << " (streaming decode)" << endl;
+    } else if (use_mmap) {
+        cout << "Input mode: mmap (zero-copy)" << endl;
+    } else if (use_ranges) {
+        cout << "Input mode: pread (" << num_readers << " parallel readers)" << endl;
+    } else {
+        cout << "Input mode: stream" << endl;
+    }
+    if (top_k > 0) {
+        cout << "Top-K: " << top_k << " words, " << sketch_size << " counters per thread"
+             << (top_k_exact ? ", exact second pass" : "") << endl;
+    }
+    cout << "Tokenizer kernel: " << kernel_name(best_kernel()) << endl;
+    cout << "Normalization: " << normalize_mode_name(normalize) << endl;
+    if (numa) {
+        cout << "NUMA: " << num_nodes << " of " << topology.num_nodes() << " nodes, threads pinned to "
+             << (numa_mode == "cores" ? "cores" : "their node") << (numa_readers ? ", node-local reads" : "") << endl;
+        for (size_t n = 0; n < num_nodes; ++n) {
+            cout << "  Node " << topology.node_id(n) << ": CPUs " << format_cpu_list(topology.node_cpus(n)) << endl;
+        }
+    }
+    if (checkpointing) {
+        cout << "Checkpoints: " << checkpoint_file;
+        if (checkpoint_interval > 0) cout << " every " << checkpoint_interval << "s and";
+        cout << " on every spill" << endl;
+    }
+    if (resumed) {
+        cout << "Resuming: " << resumed_chunks.size() << " chunks (" << format_bytes(resumed_bytes)
+             << ") already counted" << endl;
+    } else if (resume) {
+        cout << "No checkpoint found, starting from the beginning" << endl;
+    }
     
     auto start_time = chrono::high_resolution_clock::now();
     
-    ThreadSafeQueue chunk_queue;
-    GlobalWordCount global_counts;
+    // Una cola por nodo con --numa (cada hilo saca solo de la de su nodo); sin --numa una sola
+    vector<unique_ptr<ChunkQueue>> chunk_queues;
+    for (size_t n = 0; n < num_nodes; ++n) {
+        chunk_queues.push_back(make_unique<ChunkQueue>((queue_chunks + num_nodes - 1) / num_nodes));
+    }
+    vector<NodeCounters> node_counters(num_nodes);
+    for (size_t n = 0; numa && n < num_nodes; ++n) {
+        node_counters[n].node_id = topology.node_id(n);
+    }
+    // Un chunk con nodo va a la cola de ese nodo; uno sin nodo, a la menos llena
+    auto push_chunk = [&](Chunk&& item) {
+        size_t node = item.node;
+        if (node >= chunk_queues.size()) {
+            node = 0;
+            for (size_t n = 1; n < chunk_queues.size(); ++n) {
+                if (chunk_queues[n]->size() < chunk_queues[node]->size()) node = n;
+            }
+        }
+        return chunk_queues[node]->push(std::move(item));
+    };
+    auto close_queues = [&]() {
+        for (auto& queue : chunk_queues) queue->close();
+    };
+    // Hilos que no se pudieron fijar a sus CPUs (afinidad restringida)
+    atomic<size_t> unpinned_threads(0);
+
+    MemoryBudget budget(memory_budget);
+    GlobalWordCount global_counts(num_threads, budget);
     atomic<bool> stop_flag(false);
+    atomic<size_t> progress_bytes(resumed_bytes);
+    if (checkpointing) global_counts.enable_checkpoints(checkpoint);
+    if (resumed) global_counts.restore(resumed_chunks, resumed_words, resumed_bytes, temp_file);
+    
+    vector<SpaceSaving> sketches;
+    for (size_t i = 0; top_k > 0 && i < num_threads; ++i) {
+        sketches.emplace_back(sketch_size);
+    }
     
     vector<thread> threads;
     for (size_t i = 0; i < num_threads; ++i) {
-        threads.emplace_back(process_chunk, ref(chunk_queue), ref(global_counts), 
-                             ref(temp_file), memory_limit, ref(stop_flag));
+        size_t node = numa ? topology.node_of_thread(i, num_threads) : 0;
+        NodeCounters* counters = numa ? &node_counters[node] : nullptr;
+        threads.emplace_back([&, i, node, counters]() {
+            // Se fija antes de crear su tabla de conteos: las paginas quedan en el
+            // nodo del primer hilo que las escribe
+            if (numa) {
+                vector<int> cpus = numa_mode == "cores" ? vector<int>{topology.cpu_of_thread(i, num_threads)}
+                                                        : topology.node_cpus(node);
+                if (!pin_current_thread(cpus)) unpinned_threads++;
+            }
+            if (top_k > 0) {
+                process_chunk_top_k(*chunk_queues[node], sketches[i], global_counts, budget, i, stop_flag,
+                                    progress_bytes, normalize, counters);
+            } else {
+                process_chunk(*chunk_queues[node], global_counts, budget, i, temp_file, word_limit, stop_flag,
+                              progress_bytes, normalize, counters);
+            }
+        });
     }
     
-    ifstream file(input_file, ios::binary);
-    if (!file.is_open()) {
-        cerr << "Failed to open input file: " << input_file << endl;
+    // En modo mmap el archivo se mapea una sola vez y vive hasta el final del programa
+    unique_ptr<MappedFile> mapping;
+    unique_ptr<RangeReader> range_reader;
+    unique_ptr<IoEngine> io_engine;
+    unique_ptr<AsyncFileReader> async_reader;
+    unique_ptr<DecompressingReader> decoder;
+    ifstream file;
+    try {
+        if (compression != Compression::NONE) {
+            decoder = make_unique<DecompressingReader>(input_file, decode_threads);
+            cout << "Decoding: " << (decoder->is_parallel() ? to_string(decode_threads) + " threads over independent frames" : "1 thread") << endl;
+        } else if (use_mmap) {
+            mapping = make_unique<MappedFile>(input_file);
+        } else if (async_io) {
+            io_engine = make_io_engine(args.get("async-io"), io_depth);
+            async_reader = make_unique<AsyncFileReader>(*io_engine, input_file, chunk_size, io_depth, direct_io);
+            cout << "Async I/O: " << io_engine->name() << ", " << io_depth << " reads in flight"
+                 << (async_reader->is_direct() ? ", O_DIRECT" : "") << endl;
+        } else if (use_ranges) {
+            range_reader = make_unique<RangeReader>(input_file);
+        } else {
+            file.open(input_file, ios::binary);
+            if (!file.is_open()) throw runtime_error("Failed to open input file: " + input_file);
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
         stop_flag = true;
-        chunk_queue.finish();
+        close_queues();
         for (auto& thread : threads) {
             if (thread.joinable()) thread.join();
         }
         return 1;
     }
     
-    vector<char> buffer;
-    buffer.reserve(chunk_size + 1024);
+    vector<char> buffer(chunk_size + 1);
 
-    size_t bytes_processed = 0;
     size_t chunk_id = 0;
     string leftover;
     
-    atomic<size_t> progress_bytes(0);
     thread progress_thread([&]() {
         while (!stop_flag) {
             auto elapsed = chrono::duration_cast<chrono::seconds>(
                 chrono::high_resolution_clock::now() - start_time).count();
             
             if (elapsed > 0) {
-                double percentage = static_cast<double>(progress_bytes) / file_size * 100.0;
+                // Con entrada comprimida el avance se mide en bytes comprimidos ya descomprimidos
+                uint64_t done_bytes = decoder ? decoder->compressed_bytes_read() : progress_bytes.load();
+                double percentage = static_cast<double>(done_bytes) / file_size * 100.0;
                 double speed_mbps = static_cast<double>(progress_bytes) / (1024.0 * 1024.0) / elapsed;
                 
                 cout << "\rProgress: " << fixed << setprecision(2) << percentage << "% "
-                          << "(" << format_bytes(progress_bytes) << " / " << format_bytes(file_size) << ") - "
+                          << "(" << format_bytes(done_bytes) << " / " << format_bytes(file_size) << ") - "
                           << speed_mbps << " MB/s - "
                           << "Words: " << format_number(global_counts.get_total_words()) << " - "
+                          << "Unique: ~" << format_number(global_counts.estimate_unique_words()) << " - "
+                          << "Mem: " << format_bytes(budget.total()) << " - "
                           << "Time: " << elapsed << "s" << flush;
             }
             
@@ -246,15 +1424,99 @@ int main(int argc, char* argv[]) {
     });
     
     try {
-        while (file) {
+        if (mapping) {
+            split_at_whitespace(mapping->view(), chunk_size, [&](string_view slice) {
+                Chunk chunk;
+                chunk.id = chunk_id++;
+                if (resumed_chunks.contains(chunk.id)) return;  // Ya contado (--resume)
+                chunk.mapped = slice;
+                push_chunk(std::move(chunk));  // Bloquea si la cola esta llena
+            });
+        }
+        
+        if (range_reader) {
+            // Los cortes se calculan antes de leer; despues cada lector toma el
+            // siguiente rango libre sin depender del leftover de los demas
+            vector<ByteRange> ranges = range_reader->split(chunk_size);
+            atomic<size_t> next_range(0);
+            exception_ptr read_error;
+            std::mutex error_mutex;
+            
+            vector<thread> readers;
+            for (size_t r = 0; r < num_readers; ++r) {
+                readers.emplace_back([&, r]() {
+                    try {
+                        // Con --numa el lector r lee para el nodo r % nodos, desde ese nodo
+                        size_t node = r % num_nodes;
+                        if (numa && !pin_current_thread(topology.node_cpus(node))) unpinned_threads++;
+                        size_t i;
+                        while (!stop_flag && (i = next_range.fetch_add(1)) < ranges.size()) {
+                            if (resumed_chunks.contains(i)) continue;
+                            if (!budget.acquire_queue(ranges[i].size(), stop_flag)) break;
+                            Chunk item;
+                            item.id = i;
+                            item.accounted = ranges[i].size();
+                            if (numa) {
+                                // Buffer alineado a pagina para poder pedir su nodo con mbind
+                                item.node = node;
+                                item.block.buffer = make_aligned_buffer(ranges[i].size());
+                                bind_memory_to_node(item.block.buffer.get(), ranges[i].size(), topology.node_id(node));
+                                item.block.end = range_reader->read_at(ranges[i].begin, item.block.buffer.get(),
+                                                                       ranges[i].size());
+                            } else {
+                                range_reader->read(ranges[i], item.owned);
+                            }
+                            push_chunk(std::move(item));
+                        }
+                    } catch (...) {
+                        lock_guard<std::mutex> lock(error_mutex);
+                        if (!read_error) read_error = current_exception();
+                        stop_flag = true;
+                    }
+                });
+            }
+            for (auto& reader : readers) {
+                reader.join();
+            }
+            if (read_error) rethrow_exception(read_error);
+        }
+        
+        if (async_reader) {
+            // Mientras los hilos procesan un chunk ya hay io_depth lecturas en curso
+            ReadBlock block;
+            while (!stop_flag && async_reader->next(block)) {
+                size_t id = chunk_id++;
+                if (resumed_chunks.contains(id)) continue;
+                if (!budget.acquire_queue(block.size(), stop_flag)) break;
+                Chunk item;
+                item.id = id;
+                item.accounted = block.size();
+                item.block = std::move(block);
+                push_chunk(std::move(item));
+            }
+        }
+        
+        if (decoder) {
+            // La descompresion corre en sus propios hilos; aqui solo se corta en chunks
+            read_chunks(*decoder, chunk_size, [&](string&& text, uint64_t) {
+                size_t id = chunk_id++;
+                if (resumed_chunks.contains(id)) return true;
+                if (!budget.acquire_queue(text.size(), stop_flag)) return false;
+                Chunk item;
+                item.id = id;
+                item.accounted = text.size();
+                item.owned = std::move(text);
+                push_chunk(std::move(item));
+                return true;
+            });
+        }
+        
+        while (!mapping && !range_reader && !async_reader && !decoder && file) {
             file.read(buffer.data(), chunk_size + 1); // leer chunk_size + 1
             streamsize bytes_read = file.gcount();
                 
             if (bytes_read <= 0) break;
                 
-            bytes_processed += bytes_read;
-            progress_bytes = bytes_processed;
-                
             // Convertir a string
             string chunk(buffer.data(), bytes_read);
                 
@@ -275,16 +1537,33 @@ int main(int argc, char* argv[]) {
                 }
             }
         
-            chunk_queue.push(chunk, chunk_id++);
+            // Con --resume el chunk se lee igual para cortar los siguientes en el mismo sitio
+            size_t id = chunk_id++;
+            if (resumed_chunks.contains(id)) continue;
+        
+            // Backpressure: espera a que la cola vuelva a caber en el presupuesto
+            if (!budget.acquire_queue(chunk.size(), stop_flag)) break;
+
+            Chunk item;
+            item.id = id;
+            item.accounted = chunk.size();
+            item.owned = std::move(chunk);
+            push_chunk(std::move(item));
         }
         
         // Handle any remaining leftover
-        if (!leftover.empty()) {
-            chunk_queue.push(leftover, chunk_id++);
+        size_t leftover_id = chunk_id++;
+        if (!leftover.empty() && !resumed_chunks.contains(leftover_id) &&
+            budget.acquire_queue(leftover.size(), stop_flag)) {
+            Chunk item;
+            item.id = leftover_id;
+            item.accounted = leftover.size();
+            item.owned = std::move(leftover);
+            push_chunk(std::move(item));
         }
         
         // Signal that we're done reading
-        chunk_queue.finish();
+        close_queues();
         
         // Wait for all workers to finish
         for (auto& thread : threads) {
@@ -297,16 +1576,82 @@ int main(int argc, char* argv[]) {
             progress_thread.join();
         }
         
+        if (top_k > 0) {
+            // Fusion de los sketches de todos los hilos
+            SpaceSaving& sketch = sketches[0];
+            for (size_t i = 1; i < sketches.size(); ++i) {
+                sketch.merge(sketches[i]);
+            }
+
+            vector<SpaceSaving::Counter> top;
+            if (top_k_exact) {
+                // Se vuelven a contar todos los contadores del sketch, no solo los top_k,
+                // para que un error de estimacion no deje fuera a una palabra frecuente
+                cout << "\nCounting " << sketch.size() << " candidates exactly..." << endl;
+                top = sketch.top(sketch.size());
+                vector<uint64_t> exact = count_candidates(input_file, compression, chunk_size, num_threads,
+                                                          decode_threads, normalize, top);
+                for (size_t i = 0; i < top.size(); ++i) {
+                    top[i].count = exact[i];
+                    top[i].error = 0;
+                }
+                size_t keep = min(top_k, top.size());
+                partial_sort(top.begin(), top.begin() + keep, top.end(), [](const auto& a, const auto& b) {
+                    return a.count != b.count ? a.count > b.count : a.term < b.term;
+                });
+                top.resize(keep);
+            } else {
+                top = sketch.top(top_k);
+            }
+
+            cout << "\nWriting top " << top.size() << " words to " << output_file << "..." << endl;
+            write_top_k(output_file, top);
+
+            auto end_time = chrono::high_resolution_clock::now();
+            auto duration = chrono::duration_cast<chrono::seconds>(end_time - start_time).count();
+
+            cout << "\nProcessing complete!" << endl;
+            cout << "Total words: " << global_counts.get_total_words() << endl;
+            cout << "Unique words (estimate): " << global_counts.estimate_unique_words() << endl;
+            // Una palabra fuera del sketch aparece como mucho min_count veces. La segunda
+            // pasada solo corrige los conteos de los candidatos: la lista es el top-K real
+            // si el ultimo supera ese limite, si no puede faltar una palabra expulsada.
+            uint64_t max_error = sketch.min_count();
+            bool verified = true;
+            if (top_k_exact) {
+                verified = top.size() < top_k || top.empty() || top.back().count > max_error;
+                cout << "Top-K counts: exact" << endl;
+            } else {
+                cout << "Top-K counts: upper bounds, max overestimate " << max_error << endl;
+            }
+            cout << "Sketch memory: " << format_bytes(sketch.memory_bytes()) << " per thread" << endl;
+            cout << "Total time: " << duration << " seconds" << endl;
+            if (numa) print_node_counters(topology, node_counters, num_threads, unpinned_threads);
+            if (!verified) {
+                cerr << "\nTop-K not verified: words outside the sketch may have up to " << max_error
+                     << " occurrences and the last listed word has " << top.back().count
+                     << "; the list may be missing some. Raise --sketch-size." << endl;
+                return 1;
+            }
+            return 0;
+        }
+
+        // Reduce per-thread tables in parallel
+        global_counts.reduce();
+        
         // Process any intermediate results
         if (filesystem::exists(temp_file)) {
             cout << "\nMerging intermediate results..." << endl;
             global_counts.merge_from_file(temp_file);
-            filesystem::remove(temp_file);
         }
         
         // Write final results
-        cout << "\nWriting final results to " << output_file << "..." << endl;
-        global_counts.write_to_file(output_file);
+        cout << "\nWriting final results to " << output_file
+             << (partitions > 1 ? " (" + to_string(partitions) + " partitions)" : "") << "..." << endl;
+        global_counts.write_to_file(output_file, output_order, partitions);
+        // El archivo temporal y el checkpoint solo sobran cuando el resultado esta escrito
+        if (filesystem::exists(temp_file)) filesystem::remove(temp_file);
+        if (filesystem::exists(checkpoint_file)) filesystem::remove(checkpoint_file);
         
         auto end_time = chrono::high_resolution_clock::now();
         auto duration = chrono::duration_cast<chrono::seconds>(end_time - start_time).count();
@@ -314,7 +1659,9 @@ int main(int argc, char* argv[]) {
         cout << "\nProcessing complete!" << endl;
         cout << "Total words: " << global_counts.get_total_words() << endl;
         cout << "Unique words: " << global_counts.get_unique_words() << endl;
+        cout << "Unique words (HyperLogLog): " << global_counts.estimate_unique_words() << endl;
         cout << "Total time: " << duration << " seconds" << endl;
+        if (numa) print_node_counters(topology, node_counters, num_threads, unpinned_threads);
         
     } catch (const exception& e) {
         cerr << "\nError: " << e.what() << endl;
@@ -324,7 +1671,7 @@ int main(int argc, char* argv[]) {
         }
         
         // Wait for all workers to finish
-        chunk_queue.finish();
+        close_queues();
         for (auto& thread : threads) {
             if (thread.joinable()) thread.join();
         }
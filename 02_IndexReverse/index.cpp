@@ -1,4 +1,3 @@
-#include <unordered_set>
 #include <iostream>
 #include <fstream>
 #include <unordered_map>
@@ -14,83 +13,282 @@
 #include <condition_variable>
 #include <sstream>
 #include <iomanip>
-
+#include <memory>
+#include <string_view>
 #include <unordered_set>
 
+#include "../00_Common/asyncReader.hpp"
+#include "../00_Common/boundedQueue.hpp"
+#include "../00_Common/bufferedWriter.hpp"
+#include "../00_Common/checkpoint.hpp"
+#include "../00_Common/commandLine.hpp"
+#include "../00_Common/compressedInput.hpp"
+#include "../00_Common/hyperLogLog.hpp"
+#include "../00_Common/mappedFile.hpp"
+#include "../00_Common/memoryBudget.hpp"
+#include "../00_Common/parallelSort.hpp"
+#include "../00_Common/rangeReader.hpp"
+#include "../00_Common/termDictionary.hpp"
+#include "../00_Common/tokenizer.hpp"
+#include "../00_Common/workStealing.hpp"
+#include "indexManifest.hpp"
+#include "indexSegment.hpp"
+
 using namespace std;
 namespace fs = std::filesystem;
 
 // Estructura para representar un trabajo a procesar
 struct WorkItem {
-    string file_path;  // Ruta del archivo
-    size_t chunk_id;   // ID del chunk dentro del archivo
-    string content;    // Contenido del chunk
+    uint32_t doc_id = 0;  // Documento (chunk) en DocumentTable
+    string content;       // Contenido del chunk (modo stream)
+    size_t accounted = 0; // Bytes reservados en la cuota de cola (0 en modo --mmap)
+    string_view mapped;                  // Vista sobre el archivo mapeado (modo --mmap)
+    shared_ptr<const MappedFile> mapping; // Mantiene vivo el mapeo mientras se procesa
+    ReadBlock block;                      // Buffer alineado leido con --async-io
 
     WorkItem() {}
     
-    WorkItem(const string& path, size_t id, const string& data) 
-        : file_path(path), chunk_id(id), content(data) {}
+    WorkItem(uint32_t doc, string data) 
+        : doc_id(doc), content(std::move(data)) {}
+
+    WorkItem(uint32_t doc, string_view view, shared_ptr<const MappedFile> map)
+        : doc_id(doc), mapped(view), mapping(std::move(map)) {}
+
+    string_view text() const {
+        if (mapping) return mapped;
+        return block.buffer ? block.text() : string_view(content);
+    }
 };
 
-class ThreadSafeQueue {
+// Cola acotada entre el lector y los hilos (ver boundedQueue.hpp)
+using WorkQueue = BoundedQueue<WorkItem>;
+
+// Id de termino y numero de apariciones en un documento
+using TermFrequency = pair<uint32_t, uint32_t>;
+
+// Checkpoints de index (--checkpoint-interval y --resume). Los runs se escriben en
+// el directorio del checkpoint junto a un archivo CHECKPOINT (ver checkpoint.hpp):
+//
+//   options    chunk_size  normalize  positions  text  modo de entrada  directorio
+//   next_run   numero del proximo run
+//   documents  numero del archivo documents_N con la DocumentTable serializada
+//   indexed    rangos de ids de los documentos que ya estan en los runs
+//   complete   rangos de path_index de los archivos con todos sus documentos en los runs
+//   run        nombre de un run (una linea por run)
+//
+// GlobalInvertedIndex escribe un checkpoint despues de cada volcado, con el lock
+// del indice, cuando ningun documento indexado queda solo en memoria. Al
+// reanudar la tabla de documentos devuelve los mismos ids para los mismos chunks
+// (ver DocumentTable::restore): los archivos completos no se vuelven a leer y los
+// documentos ya indexados de un archivo a medias se saltan.
+class IndexCheckpoint {
 private:
-    queue<WorkItem> queue_t;
-    std::mutex mutex;
-    condition_variable cv;
-    bool finished = false;
-    size_t current_size = 0;
+    string directory;
+    CheckpointFile options;
+    chrono::seconds interval;
+    chrono::steady_clock::time_point next_time;
+    uint64_t documents_number = 0;  // 0: todavia no hay archivo de documentos
+    // Archivos con todos sus chunks registrados en DocumentTable
+    CompletedSet registered_paths;
+    std::mutex registered_mutex;
+    // Estado cargado con --resume; no cambia despues de load
+    CompletedSet restored_docs;
+    unordered_set<string> complete_files;
+    vector<string> restored_runs;
+    size_t restored_next_run = 0;
+
+    string documents_path(uint64_t number) const {
+        return directory + "/documents_" + to_string(number);
+    }
 
 public:
-    void push(const WorkItem& item) {
-        unique_lock<std::mutex> lock(mutex);
-        queue_t.push(item);
-        current_size++;
-        cv.notify_one();
+    static constexpr const char* FILE_NAME = "CHECKPOINT";
+
+    IndexCheckpoint(const string& checkpoint_directory, const CheckpointFile& input_options, size_t interval_seconds)
+        : directory(checkpoint_directory), options(input_options), interval(interval_seconds),
+          next_time(chrono::steady_clock::now() + interval) {
+        fs::create_directories(directory);
     }
 
-    bool pop(WorkItem& item) {
-        unique_lock<std::mutex> lock(mutex);
-        cv.wait(lock, [this] { return !queue_t.empty() || finished; });
-        
-        if (queue_t.empty() && finished) {
+    const string& get_directory() const {
+        return directory;
+    }
+
+    bool due() const {
+        return interval.count() > 0 && chrono::steady_clock::now() >= next_time;
+    }
+
+    // El lector ya registro todos los chunks del archivo; en cuanto esten todos en
+    // los runs el archivo cuenta como completo
+    void registered(uint32_t path_index) {
+        lock_guard<std::mutex> lock(registered_mutex);
+        registered_paths.insert(path_index);
+    }
+
+    bool is_complete(const string& path) const {
+        return complete_files.count(path) > 0;
+    }
+
+    bool was_indexed(uint32_t doc_id) const {
+        return restored_docs.contains(doc_id);
+    }
+
+    const CompletedSet& indexed_documents() const {
+        return restored_docs;
+    }
+
+    const vector<string>& runs() const {
+        return restored_runs;
+    }
+
+    size_t next_run() const {
+        return restored_next_run;
+    }
+
+    // Carga el ultimo checkpoint del directorio en documents. Devuelve false si no
+    // hay ninguno; los archivos que no aparecen en el (runs escritos despues del
+    // ultimo checkpoint) se borran.
+    bool load(DocumentTable& documents) {
+        string path = directory + "/" + FILE_NAME;
+        if (!CheckpointFile::exists(path)) {
+            // Runs de una ejecucion que se corto antes de su primer checkpoint
+            for (const auto& entry : fs::directory_iterator(directory)) {
+                fs::remove_all(entry.path());
+            }
             return false;
         }
-        
-        item = queue_t.front();
-        queue_t.pop();
-        current_size--;
+        CheckpointFile saved;
+        saved.load(path);
+        if (!saved.same(options, "options")) {
+            throw runtime_error("Checkpoint in " + directory + " was written with other options or another input directory");
+        }
+        restored_next_run = stoull(saved.get("next_run", 1)[0]);
+        documents_number = stoull(saved.get("documents", 1)[0]);
+
+        ifstream in(documents_path(documents_number), ios::binary);
+        string table((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+        if (!in.good() && !in.eof()) throw runtime_error("Failed to read " + documents_path(documents_number));
+        documents.restore(table.data(), table.data() + table.size(), SEGMENT_VERSION);
+
+        restored_docs = CompletedSet::parse(saved.get("indexed", 1)[0]);
+        CompletedSet complete = CompletedSet::parse(saved.get("complete", 1)[0]);
+        for (uint32_t i = 0; i < documents.num_paths(); ++i) {
+            if (!complete.contains(i)) continue;
+            complete_files.insert(documents.path_name(i));
+            registered_paths.insert(i);
+        }
+
+        unordered_set<string> referenced = {FILE_NAME, fs::path(documents_path(documents_number)).filename().string()};
+        for (const auto& run : saved.get_all("run", 1)) {
+            restored_runs.push_back(directory + "/" + run[0]);
+            referenced.insert(run[0]);
+            if (!fs::exists(restored_runs.back())) throw runtime_error("Checkpoint run is missing: " + restored_runs.back());
+        }
+        for (const auto& entry : fs::directory_iterator(directory)) {
+            if (!referenced.count(entry.path().filename().string())) fs::remove(entry.path());
+        }
         return true;
     }
 
-    void finish() {
-        unique_lock<std::mutex> lock(mutex);
-        finished = true;
-        cv.notify_all();
-    }
+    // Se llama con el lock del indice justo despues de un volcado: indexed son los
+    // documentos que estan en runs, que ya estan en disco
+    void save(const vector<string>& runs, size_t next_run, const CompletedSet& indexed, const DocumentTable& documents) {
+        // Primero las rutas registradas y despues la tabla, para que todos los chunks
+        // de una ruta registrada esten en la tabla que se guarda
+        CompletedSet registered;
+        {
+            lock_guard<std::mutex> lock(registered_mutex);
+            registered = registered_paths;
+        }
+        size_t num_paths = documents.num_paths();
+        size_t num_docs = documents.size();
+        string table;
+        documents.serialize(table);
 
-    bool is_empty() {
-        unique_lock<std::mutex> lock(mutex);
-        return queue_t.empty();
+        vector<bool> incomplete(num_paths, false);
+        for (uint32_t doc = 0; doc < num_docs; ++doc) {
+            if (!indexed.contains(doc)) incomplete[documents.get(doc).path_index] = true;
+        }
+        CompletedSet complete;
+        for (uint32_t i = 0; i < num_paths; ++i) {
+            if (registered.contains(i) && !incomplete[i]) complete.insert(i);
+        }
+
+        uint64_t number = documents_number + 1;
+        {
+            ofstream out(documents_path(number), ios::binary | ios::trunc);
+            out.write(table.data(), static_cast<streamsize>(table.size()));
+            out.close();
+            if (!out) throw runtime_error("Failed to write " + documents_path(number));
+        }
+        sync_file(documents_path(number));
+
+        CheckpointFile state = options;
+        state.set("next_run", {to_string(next_run)});
+        state.set("documents", {to_string(number)});
+        state.set("indexed", {indexed.to_string()});
+        state.set("complete", {complete.to_string()});
+        for (const auto& run : runs) {
+            state.add("run", {fs::path(run).filename().string()});
+        }
+        state.save(directory + "/" + FILE_NAME);
+
+        error_code error;
+        if (documents_number > 0) fs::remove(documents_path(documents_number), error);
+        documents_number = number;
+        next_time = chrono::steady_clock::now() + interval;
     }
-    
-    size_t size() {
-        unique_lock<std::mutex> lock(mutex);
-        return current_size;
+
+    // Con la salida ya escrita el checkpoint y sus runs sobran
+    void finish() {
+        error_code error;
+        fs::remove_all(directory, error);
     }
 };
 
 class GlobalInvertedIndex {
 private:
-    unordered_map<string, unordered_set<string>> index;
+    // Los terminos se guardan una sola vez en el diccionario; el indice y las
+    // fusiones de archivos temporales trabajan con sus ids
+    TermDictionary dictionary;
+    DocumentTable& documents;
+    unordered_map<uint32_t, PostingList> index;
+    // Solo con --positions: posiciones de cada termino en el orden de sus postings
+    // en index (ver encode_positions), fuera de index para no engordar sus entradas
+    unordered_map<uint32_t, string> positions;
+    bool positional;
     std::mutex mutex;
+    MemoryBudget& budget;
+    size_t index_bytes = 0;  // Memoria aproximada de index (nodos + postings)
     size_t max_memory_words;
     string temp_dir;
     size_t temp_file_counter = 0;
-    vector<string> temp_files;
+    vector<string> temp_files;  // Runs ordenados por termino (segmentos sin documentos)
+    // Solo con checkpoints: documentos que ya estan en el indice o en los runs
+    IndexCheckpoint* checkpoint = nullptr;
+    CompletedSet indexed_docs;
+    // HyperLogLog de terminos distintos de cada hilo indexador
+    vector<unique_ptr<HyperLogLog>> worker_distinct;
+    std::mutex distinct_mutex;
+    // Un volcado fallido deja el indice incompleto: no se reintenta y el trabajo falla
+    atomic<bool> flush_failed{false};
+    string flush_error;
+    atomic<bool>* stop_flag = nullptr;
+    
+    // Número máximo de runs que se abren a la vez en la fusión
+    static constexpr size_t MAX_MERGE_FAN_IN = 64;
+    // Coste aproximado de cada entrada nueva del mapa (nodo + bucket + vector vacio)
+    static constexpr size_t INDEX_ENTRY_OVERHEAD = sizeof(uint32_t) + sizeof(PostingList) + 3 * sizeof(void*);
+    static constexpr size_t POSITIONS_ENTRY_OVERHEAD = sizeof(uint32_t) + sizeof(string) + 3 * sizeof(void*);
+    // El diccionario no se vacia en los volcados; un run nunca es menor que esta
+    // fraccion del presupuesto para no volcar en cada chunk si el diccionario crece
+    static constexpr size_t MIN_RUN_FRACTION = 8;
 
 public:
-    GlobalInvertedIndex(size_t max_words = 5000000, const string& tmp_dir = "") 
-        : max_memory_words(max_words), temp_dir(tmp_dir) {
+    GlobalInvertedIndex(DocumentTable& docs, MemoryBudget& memory_budget,
+                        size_t max_words = SIZE_MAX, const string& tmp_dir = "", bool with_positions = false) 
+        : documents(docs), positional(with_positions), budget(memory_budget), max_memory_words(max_words),
+          temp_dir(tmp_dir) {
         // Si no se especifica un directorio temporal, usar el directorio actual
         if (temp_dir.empty()) {
             temp_dir = fs::temp_directory_path().string();
@@ -108,6 +306,8 @@ public:
     }
 
     ~GlobalInvertedIndex() {
+        // Con checkpoints los runs son del checkpoint: se conservan para --resume
+        if (checkpoint) return;
         // Limpiar archivos temporales al destruir el objeto
         for (const auto& file : temp_files) {
             try {
@@ -121,201 +321,911 @@ public:
         }
     }
 
-    void merge(const unordered_map<string, unordered_set<string>>& local_index) {
+    TermDictionary& get_dictionary() {
+        return dictionary;
+    }
+
+    bool has_positions() const {
+        return positional;
+    }
+
+    // Los runs se escriben en el directorio del checkpoint y cada volcado termina con
+    // un checkpoint. Si se reanuda, se parte de los runs y documentos ya indexados.
+    void enable_checkpoints(IndexCheckpoint& state) {
+        checkpoint = &state;
+        temp_dir = state.get_directory();
+        temp_files = state.runs();
+        temp_file_counter = state.next_run();
+        indexed_docs = state.indexed_documents();
+    }
+
+    // Si un volcado falla se activa stop para que lectores e hilos dejen de trabajar
+    void stop_on_failure(atomic<bool>& stop) {
+        stop_flag = &stop;
+    }
+
+    bool failed() const {
+        return flush_failed;
+    }
+
+    const string& failure() const {
+        return flush_error;
+    }
+
+    // Documento que ya estaba en los runs del checkpoint cargado con --resume
+    bool already_indexed(uint32_t doc_id) const {
+        return checkpoint && checkpoint->was_indexed(doc_id);
+    }
+
+    // Estimador propio de un hilo nuevo; vive tanto como el indice
+    HyperLogLog& register_worker() {
+        lock_guard<std::mutex> lock(distinct_mutex);
+        worker_distinct.push_back(make_unique<HyperLogLog>());
+        return *worker_distinct.back();
+    }
+
+    // Terminos distintos estimados sin tomar el lock del indice
+    uint64_t estimate_unique_terms() {
+        HyperLogLog merged;
+        lock_guard<std::mutex> lock(distinct_mutex);
+        for (const auto& distinct : worker_distinct) {
+            merged.merge(*distinct);
+        }
+        return merged.estimate();
+    }
+
+    // Añade un documento (chunk) con los terminos que aparecen en el, cada uno con
+    // su frecuencia, y su longitud en palabras. Con posiciones, term_positions
+    // tiene las de cada termino seguidas en el orden de term_freqs.
+    void merge(const vector<TermFrequency>& term_freqs, uint32_t doc_id, uint32_t doc_length,
+               const vector<uint32_t>* term_positions = nullptr) {
+        documents.set_length(doc_id, doc_length);
         unique_lock<std::mutex> lock(mutex);
+        if (flush_failed) return;
         
-        // Añadir el índice local al global
-        for (const auto& [word, doc_ids] : local_index) {
-            index[word].insert(doc_ids.begin(), doc_ids.end());
+        // Añadir el documento al índice global
+        if (checkpoint) indexed_docs.insert(doc_id);
+        const uint32_t* next_position = term_positions ? term_positions->data() : nullptr;
+        for (const auto& [term_id, freq] : term_freqs) {
+            auto [it, inserted] = index.try_emplace(term_id);
+            if (inserted) index_bytes += INDEX_ENTRY_OVERHEAD;
+            size_t capacity = it->second.capacity();
+            it->second.push_back({doc_id, freq});
+            index_bytes += (it->second.capacity() - capacity) * sizeof(Posting);
+
+            if (next_position) {
+                auto [pos_it, pos_inserted] = positions.try_emplace(term_id);
+                if (pos_inserted) index_bytes += POSITIONS_ENTRY_OVERHEAD;
+                string& encoded = pos_it->second;
+                capacity = encoded.capacity();
+                uint32_t previous = 0;
+                for (uint32_t i = 0; i < freq; ++i) {
+                    put_varint(encoded, next_position[i] - previous);
+                    previous = next_position[i];
+                }
+                next_position += freq;
+                index_bytes += encoded.capacity() - capacity;
+            }
         }
+        budget.set(MemoryBudget::INDEX, index_bytes);
+        budget.set(MemoryBudget::DICTIONARY, dictionary.memory_bytes());
         
-        // Si el índice global es demasiado grande, guardarlo en un archivo temporal
-        if (index.size() > max_memory_words) {
-            flush_to_temp_file();
+        // Si el índice global no cabe en el presupuesto (o supera el limite opcional
+        // de palabras), guardarlo en un archivo temporal. Un checkpoint tambien vuelca.
+        bool over_budget = budget.data_over_budget() &&
+                           index_bytes >= budget.data_limit() / MIN_RUN_FRACTION;
+        if (over_budget || index.size() > max_memory_words || (checkpoint && checkpoint->due())) {
+            try {
+                flush_to_temp_file();
+            } catch (const exception& e) {
+                cerr << "\n" << e.what() << endl;
+                flush_error = e.what();
+                flush_failed = true;
+                if (stop_flag) *stop_flag = true;
+            }
         }
     }
     
+    // Ids de los terminos del mapa ordenados por el texto del termino. En un volcado
+    // los demas hilos esperan el lock del indice, asi que se ordena con todos los nucleos.
+    vector<uint32_t> sorted_terms(const unordered_map<uint32_t, PostingList>& postings) const {
+        vector<uint32_t> term_ids;
+        term_ids.reserve(postings.size());
+        for (const auto& entry : postings) {
+            term_ids.push_back(entry.first);
+        }
+        parallel_sort(term_ids.begin(), term_ids.end(), [this](uint32_t a, uint32_t b) {
+            return dictionary.term(a) < dictionary.term(b);
+        }, max(1u, thread::hardware_concurrency()));
+        return term_ids;
+    }
+
+    // Escribe un segmento binario con los terminos en orden y los postings ordenados
+    void write_segment(unordered_map<uint32_t, PostingList>& postings, const string& path,
+                       const DocumentTable* docs) {
+        SegmentWriter writer(path, positional);
+        for (uint32_t term_id : sorted_terms(postings)) {
+            PostingList& list = postings[term_id];
+            if (positional) {
+                string& term_positions = positions[term_id];
+                sort_postings(list, term_positions);
+                writer.add(dictionary.term(term_id), list, term_positions);
+            } else {
+                sort(list.begin(), list.end());
+                writer.add(dictionary.term(term_id), list);
+            }
+        }
+        writer.finish(docs);
+    }
+
+    // Lanza runtime_error si el run no se pudo escribir; el indice en memoria se conserva
     void flush_to_temp_file() {
         if (index.empty()) return;
         
-        string temp_filename = temp_dir + "/index_temp_" + to_string(temp_file_counter++) + ".tmp";
-        ofstream temp_file(temp_filename);
-        
-        if (!temp_file.is_open()) {
-            cerr << "Failed to open temp file: " << temp_filename << endl;
-            return;
-        }
+        string temp_filename = temp_dir + "/index_temp_" + to_string(temp_file_counter++) + ".seg";
         
-        // Escribir el índice actual al archivo temporal
-        for (const auto& [word, docs] : index) {
-            temp_file << word;
-            for (const auto& doc : docs) {
-                temp_file << " " << doc;
-            }
-            temp_file << "\n";
+        // Escribir el índice actual al archivo temporal (segmento binario sin documentos)
+        try {
+            write_segment(index, temp_filename, nullptr);
+            if (checkpoint) sync_file(temp_filename);
+        } catch (const exception& e) {
+            error_code error;
+            fs::remove(temp_filename, error);
+            throw runtime_error("Failed to write temp file " + temp_filename + ": " + e.what());
         }
         
-        temp_file.close();
         temp_files.push_back(temp_filename);
         
-        // Limpiar el índice en memoria
-        index.clear();
+        // Limpiar el índice en memoria. El siguiente run tendra como mucho tantos
+        // terminos como este o como el total estimado, asi que se reserva ya
+        size_t flushed_terms = index.size();
+        unordered_map<uint32_t, PostingList>().swap(index);
+        index.reserve(min<uint64_t>(flushed_terms, estimate_unique_terms()));
+        if (positional) {
+            unordered_map<uint32_t, string>().swap(positions);
+            positions.reserve(index.bucket_count());
+        }
+        index_bytes = 0;
+        budget.set(MemoryBudget::INDEX, 0);
         
         cout << "\nFlushed index to temporary file: " << temp_filename << endl;
         cout << "Current memory usage reduced." << endl;
+        if (checkpoint) save_checkpoint(temp_files);
     }
 
-    void write_to_file(const string& filename) {
-        // Si hay archivos temporales, primero combinar todo
-        if (!temp_files.empty()) {
-            merge_temp_files();pop
-        }
-        
-        ofstream file(filename);
-        if (!file.is_open()) {
-            cerr << "Failed to open output file: " << filename << endl;
-            return;
+    // Si el checkpoint falla el anterior sigue siendo valido: solo se avisa
+    bool save_checkpoint(const vector<string>& runs) {
+        try {
+            checkpoint->save(runs, temp_file_counter, indexed_docs, documents);
+            cout << "Checkpoint: " << indexed_docs.size() << " documents in " << runs.size() << " runs" << endl;
+            return true;
+        } catch (const exception& e) {
+            cerr << "Failed to write checkpoint: " << e.what() << endl;
+            return false;
         }
+    }
 
-        for (const auto& [word, docs] : index) {
-            file << word;
-            for (const auto& doc : docs) {
-                file << " " << doc;
-            }
-            file << "\n";
+    // Escribe el resultado final como segmento binario o, con text_output, en el
+    // formato de texto "palabra doc doc ...". Devuelve false si no se pudo escribir.
+    bool write_to_file(const string& filename, bool text_output) {
+        if (flush_failed) {
+            cerr << "Index is incomplete: " << flush_error << endl;
+            return false;
         }
-
-        file.close();
-    }
-    
-    void merge_temp_files() {
-        cout << "\nMerging " << temp_files.size() << " temporary files..." << endl;
         
-        // Si tenemos demasiados archivos, los combinamos iterativamente
-        while (temp_files.size() > 10) { // Establecemos un límite arbitrario
-            vector<string> new_temp_files;
+        try {
+            // Si hubo volcados, el resto del índice en memoria se vuelca también y todos
+            // los runs ordenados se fusionan en streaming directamente a la salida
+            if (!temp_files.empty()) {
+                flush_to_temp_file();
+                reduce_runs();
+                cout << "\nMerging " << temp_files.size() << " sorted runs..." << endl;
+            }
             
-            for (size_t i = 0; i < temp_files.size(); i += 10) {
-                size_t end = min(i + 10, temp_files.size());
-                string new_temp = temp_dir + "/index_merged_" + to_string(temp_file_counter++) + ".tmp";
-                
-                merge_files(vector<string>(temp_files.begin() + i, temp_files.begin() + end), new_temp);
-                new_temp_files.push_back(new_temp);
-                
-                // Eliminar archivos temporales que ya se han combinado
-                for (size_t j = i; j < end; ++j) {
-                    fs::remove(temp_files[j]);
+            if (!text_output) {
+                if (temp_files.empty()) {
+                    write_segment(index, filename, &documents);
+                } else {
+                    SegmentWriter writer(filename, positional);
+                    merge_runs(temp_files, [&](string_view term, const PostingList& docs, string_view term_positions) {
+                        writer.add(term, docs, term_positions);
+                    });
+                    writer.finish(&documents);
+                }
+                if (!checkpoint) remove_runs();
+                return true;
+            }
+            
+            BufferedWriter file(filename);
+            
+            // Los ids de documento se traducen a texto solo aqui, una vez por documento
+            vector<string> names(documents.size());
+            for (uint32_t doc = 0; doc < names.size(); ++doc) {
+                names[doc] = documents.name(doc);
+            }
+            auto write_line = [&](string_view term, const PostingList& docs, string_view) {
+                file.write(term);
+                for (const auto& posting : docs) {
+                    file.put(' ');
+                    file.write(names[posting.doc]);
+                }
+                file.put('\n');
+            };
+            
+            if (temp_files.empty()) {
+                for (uint32_t term_id : sorted_terms(index)) {
+                    PostingList& docs = index[term_id];
+                    sort(docs.begin(), docs.end());
+                    write_line(dictionary.term(term_id), docs, string_view());
                 }
+            } else {
+                merge_runs(temp_files, write_line);
             }
             
-            temp_files = new_temp_files;
+            file.close();
+            if (!checkpoint) remove_runs();
+        } catch (const exception& e) {
+            cerr << "Failed to write output file: " << e.what() << endl;
+            return false;
+        }
+        return true;
+    }
+    
+    // Fusion k-way en streaming de runs ordenados por termino. Un heap guarda el
+    // termino actual de cada run y solo los postings del termino en curso están
+    // en memoria, así que el coste es constante por run.
+    template <typename Sink>
+    void merge_runs(const vector<string>& runs, Sink&& sink) {
+        vector<unique_ptr<SegmentReader>> readers;
+        vector<SegmentReader::Iterator> cursors;
+        for (const auto& run : runs) {
+            readers.push_back(make_unique<SegmentReader>(run));
+            cursors.push_back(readers.back()->terms());
         }
         
-        // Combinar los archivos temporales restantes con el índice en memoria
-        for (const auto& temp_file : temp_files) {
-            merge_file_to_memory(temp_file);
-            fs::remove(temp_file);
+        auto greater_term = [&](size_t a, size_t b) {
+            int cmp = cursors[a].entry().term.compare(cursors[b].entry().term);
+            return cmp > 0 || (cmp == 0 && a > b);
+        };
+        priority_queue<size_t, vector<size_t>, decltype(greater_term)> heap(greater_term);
+        for (size_t i = 0; i < cursors.size(); ++i) {
+            if (cursors[i].next()) heap.push(i);
         }
         
-        temp_files.clear();
+        string term;
+        PostingList merged;
+        PostingList docs;
+        string merged_positions;
+        while (!heap.empty()) {
+            term.assign(cursors[heap.top()].entry().term);
+            merged.clear();
+            merged_positions.clear();
+            bool sorted = true;
+            
+            while (!heap.empty() && cursors[heap.top()].entry().term == term) {
+                size_t run = heap.top();
+                heap.pop();
+                cursors[run].postings(docs);
+                if (!merged.empty() && !docs.empty() && docs.front() < merged.back()) sorted = false;
+                merged.insert(merged.end(), docs.begin(), docs.end());
+                if (positional) merged_positions.append(cursors[run].positions());
+                if (cursors[run].next()) heap.push(run);
+            }
+            
+            // Los documentos de runs distintos pueden intercalarse
+            if (!sorted) {
+                if (positional) {
+                    sort_postings(merged, merged_positions);
+                } else {
+                    sort(merged.begin(), merged.end());
+                }
+            }
+            sink(string_view(term), merged, string_view(merged_positions));
+        }
     }
     
-    void merge_files(const vector<string>& files, const string& output) {
-        // Mapa temporal para combinar índices
-        unordered_map<string, unordered_set<string>> merged_index;
-        
-        for (const auto& file : files) {
-            ifstream in(file);
-            if (!in.is_open()) continue;
-            
-            string line;
-            while (getline(in, line)) {
-                istringstream iss(line);
-                string word;
-                iss >> word;
+    // Si hay más runs de los que conviene abrir a la vez, se fusionan por grupos
+    // en runs intermedios (también en streaming) hasta quedar MAX_MERGE_FAN_IN
+    void reduce_runs() {
+        while (temp_files.size() > MAX_MERGE_FAN_IN) {
+            vector<string> next_runs;
+            for (size_t i = 0; i < temp_files.size(); i += MAX_MERGE_FAN_IN) {
+                size_t end = min(i + MAX_MERGE_FAN_IN, temp_files.size());
+                vector<string> group(temp_files.begin() + i, temp_files.begin() + end);
+                string merged = temp_dir + "/index_merged_" + to_string(temp_file_counter++) + ".seg";
+                
+                SegmentWriter writer(merged, positional);
+                merge_runs(group, [&](string_view term, const PostingList& docs, string_view term_positions) {
+                    writer.add(term, docs, term_positions);
+                });
+                writer.finish();
+                next_runs.push_back(merged);
                 
-                string doc_id;
-                while (iss >> doc_id) {
-                    merged_index[word].insert(doc_id);
+                // El checkpoint deja de usar los runs del grupo antes de borrarlos; si no
+                // se pudo escribir se quedan hasta que se borre su directorio
+                bool release = true;
+                if (checkpoint) {
+                    sync_file(merged);
+                    vector<string> current = next_runs;
+                    current.insert(current.end(), temp_files.begin() + end, temp_files.end());
+                    release = save_checkpoint(current);
+                }
+                for (const auto& run : group) {
+                    if (release) fs::remove(run);
                 }
             }
-            
-            in.close();
+            temp_files = next_runs;
         }
-        
-        // Escribir el índice combinado
-        ofstream out(output);
-        if (!out.is_open()) {
-            cerr << "Failed to open merged temp file: " << output << endl;
-            return;
+    }
+    
+    void remove_runs() {
+        for (const auto& run : temp_files) {
+            fs::remove(run);
+        }
+        temp_files.clear();
+    }
+
+    // El diccionario no se vacia en los volcados, asi que su tamaño es exacto
+    size_t get_total_words() const {
+        return dictionary.size();
+    }
+};
+
+// Estado por hilo para indexar chunks: tokenizador, cache de ids y la marca de
+// terminos ya vistos en el chunk actual. Lo usan tanto los hilos de la cola como
+// los del planificador con robo de trabajo.
+class ChunkIndexer {
+private:
+    GlobalInvertedIndex& global_index;
+    MemoryBudget& budget;
+    Tokenizer tokenizer;
+    TermCache terms;
+    HyperLogLog& distinct;
+    vector<TermFrequency> doc_terms;
+    // seen[id].stamp == stamp si el termino ya aparecio en el chunk actual; en ese
+    // caso seen[id].slot es su posicion en doc_terms
+    struct SeenTerm {
+        uint64_t stamp = 0;
+        uint32_t slot = 0;
+    };
+    vector<SeenTerm> seen;
+    uint64_t stamp = 0;
+    size_t reported_bytes = 0;  // Memoria de este hilo ya informada al presupuesto
+    // Solo con posiciones: slot en doc_terms de cada palabra del chunk, en orden,
+    // y las posiciones agrupadas por termino en el orden final de doc_terms
+    bool positional;
+    vector<uint32_t> token_slots;
+    vector<uint32_t> doc_positions;
+    vector<uint32_t> slot_order;
+    vector<uint32_t> slot_offsets;
+
+    // Ordena doc_terms por id y reparte las posiciones de token_slots en
+    // doc_positions: las de cada termino seguidas y en orden creciente
+    void group_positions() {
+        slot_order.resize(doc_terms.size());
+        for (uint32_t i = 0; i < slot_order.size(); ++i) slot_order[i] = i;
+        sort(slot_order.begin(), slot_order.end(), [&](uint32_t a, uint32_t b) {
+            return doc_terms[a].first < doc_terms[b].first;
+        });
+        slot_offsets.resize(doc_terms.size());
+        uint32_t total = 0;
+        for (uint32_t slot : slot_order) {
+            slot_offsets[slot] = total;
+            total += doc_terms[slot].second;
         }
+        doc_positions.resize(total);
+        for (uint32_t position = 0; position < token_slots.size(); ++position) {
+            doc_positions[slot_offsets[token_slots[position]]++] = position;
+        }
+        sort(doc_terms.begin(), doc_terms.end());
+    }
+
+public:
+    ChunkIndexer(GlobalInvertedIndex& index, MemoryBudget& memory_budget, unsigned normalize)
+        : global_index(index), budget(memory_budget), tokenizer(normalize), terms(index.get_dictionary()),
+          distinct(index.register_worker()), positional(index.has_positions()) {}
+
+    ~ChunkIndexer() {
+        budget.add(MemoryBudget::TABLES, -static_cast<int64_t>(reported_bytes));
+    }
+
+    void index(string_view chunk, uint32_t doc_id) {
+        // Con --resume, un chunk que ya estaba en los runs del checkpoint
+        if (global_index.already_indexed(doc_id)) return;
         
-        for (const auto& [word, docs] : merged_index) {
-            out << word;
-            for (const auto& doc : docs) {
-                out << " " << doc;
+        // Ids de los terminos del chunk, sin repetidos, con su frecuencia
+        doc_terms.clear();
+        token_slots.clear();
+        stamp++;
+        uint32_t doc_length = 0;
+        tokenizer.tokenize(chunk, [&](string_view word) {
+            uint32_t id = terms.lookup(word);
+            if (id >= seen.size()) {
+                seen.resize(max<size_t>(id + 1, seen.size() * 2));
             }
-            out << "\n";
-        }
+            SeenTerm& term = seen[id];
+            if (term.stamp != stamp) {
+                // 0 si este hilo no habia visto nunca el termino
+                if (term.stamp == 0) distinct.add(word);
+                term.stamp = stamp;
+                term.slot = static_cast<uint32_t>(doc_terms.size());
+                doc_terms.push_back({id, 0});
+            }
+            doc_terms[term.slot].second++;
+            doc_length++;
+            if (positional) token_slots.push_back(term.slot);
+        });
         
-        out.close();
+        if (positional) {
+            group_positions();
+            global_index.merge(doc_terms, doc_id, doc_length, &doc_positions);
+        } else {
+            sort(doc_terms.begin(), doc_terms.end());
+            global_index.merge(doc_terms, doc_id, doc_length);
+        }
+
+        size_t bytes = seen.capacity() * sizeof(SeenTerm) +
+                       doc_terms.capacity() * sizeof(TermFrequency) + terms.memory_bytes() +
+                       (token_slots.capacity() + doc_positions.capacity() + slot_order.capacity() +
+                        slot_offsets.capacity()) * sizeof(uint32_t);
+        budget.add(MemoryBudget::TABLES, static_cast<int64_t>(bytes) - static_cast<int64_t>(reported_bytes));
+        reported_bytes = bytes;
+    }
+};
+
+void process_chunk(WorkQueue& queue, GlobalInvertedIndex& global_index, MemoryBudget& budget,
+    atomic<bool>& stop_flag, atomic<size_t>& progress_bytes, unsigned normalize) {
+    WorkItem item;
+    ChunkIndexer indexer(global_index, budget, normalize);
+
+    while (queue.pop(item)) {
+        // Tras un error la cola se sigue vaciando para que ningun lector se quede en push
+        if (!stop_flag) {
+            string_view chunk = item.text();
+            indexer.index(chunk, item.doc_id);
+            progress_bytes.fetch_add(chunk.size());
+        }
+        budget.release_queue(item.accounted);
+        item = WorkItem();
     }
+}
+
+// Descomprime un archivo en streaming y lo corta en chunks que se registran como
+// documentos archivo_chunk_N (el offset es la posicion en el texto descomprimido).
+// on_chunk(doc_id, texto) devuelve false para dejar de leer. Devuelve el path_index.
+template <typename Callback>
+uint32_t read_compressed_file(const string& path, size_t chunk_size, size_t decode_threads,
+    DocumentTable& documents, Callback&& on_chunk) {
+    DecompressingReader decoder(path, decode_threads);
+    uint32_t path_index = documents.add_path(path);
+    uint32_t chunk_id = 0;
+    read_chunks(decoder, chunk_size, [&](string&& text, uint64_t offset) {
+        return on_chunk(documents.add(path_index, chunk_id++, offset), std::move(text));
+    });
+    return path_index;
+}
+
+// Lectura con varios hilos (--readers). Primero se cortan todos los archivos en
+// rangos (los mismos cortes que --mmap) y se registran sus documentos en orden,
+// asi los ids y nombres no dependen del orden de lectura; despues cada lector toma
+// el siguiente rango libre y lo lee con pread. Los archivos comprimidos no se
+// pueden cortar antes de descomprimirlos: los descomprime todos el primer lector,
+// en el orden de la lista, antes de unirse a los rangos, asi que sus documentos
+// tienen los ids siguientes a los de los rangos. Con --resume no se leen los
+// rangos que ya estaban indexados en el checkpoint.
+void read_files_parallel(const vector<fs::path>& file_list, size_t chunk_size, size_t num_readers,
+    DocumentTable& documents, WorkQueue& queue, MemoryBudget& budget,
+    atomic<bool>& stop_flag, atomic<size_t>& files_processed, IndexCheckpoint* checkpoint) {
+    struct ReadTask {
+        size_t file = 0;
+        uint32_t doc_id = 0;
+        ByteRange range;
+        bool last = false;  // Ultimo rango del archivo
+    };
     
-    void merge_file_to_memory(const string& file_path) {
-        ifstream in(file_path);
-        if (!in.is_open()) return;
-        
-        string line;
-        while (getline(in, line)) {
-            istringstream iss(line);
-            string word;
-            iss >> word;
-            
-            string doc_id;
-            while (iss >> doc_id) {
-                index[word].insert(doc_id);
+    vector<ReadTask> tasks;
+    vector<size_t> compressed_files;
+    for (size_t f = 0; f < file_list.size() && !stop_flag; ++f) {
+        try {
+            if (detect_compression_file(file_list[f].string()) != Compression::NONE) {
+                compressed_files.push_back(f);
+                continue;
             }
+            RangeReader reader(file_list[f].string());
+            uint32_t path_index = documents.add_path(file_list[f].string());
+            vector<ByteRange> ranges = reader.split(chunk_size);
+            size_t first_task = tasks.size();
+            for (uint32_t c = 0; c < ranges.size(); ++c) {
+                uint32_t doc_id = documents.add(path_index, c, ranges[c].begin);
+                if (checkpoint && checkpoint->was_indexed(doc_id)) continue;
+                tasks.push_back({f, doc_id, ranges[c]});
+            }
+            if (tasks.size() > first_task) {
+                tasks.back().last = true;
+            } else {
+                files_processed.fetch_add(1);
+            }
+            if (checkpoint) checkpoint->registered(path_index);
+        } catch (const exception& e) {
+            cerr << "\nError processing file " << file_list[f] << ": " << e.what() << endl;
         }
-        
-        in.close();
     }
-
-    size_t get_total_words() const {
-        return index.size() + (temp_files.size() * max_memory_words / 2); // Estimación
+    
+    atomic<size_t> next_task(0);
+    vector<thread> readers;
+    for (size_t r = 0; r < num_readers; ++r) {
+        readers.emplace_back([&, r]() {
+            // Solo este hilo registra documentos mientras los demas leen rangos
+            for (size_t c = 0; r == 0 && c < compressed_files.size() && !stop_flag; ++c) {
+                const fs::path& path = file_list[compressed_files[c]];
+                try {
+                    uint32_t path_index = read_compressed_file(path.string(), chunk_size, 1, documents,
+                        [&](uint32_t doc_id, string&& text) {
+                            if (!budget.acquire_queue(text.size(), stop_flag)) return false;
+                            WorkItem item(doc_id, std::move(text));
+                            item.accounted = item.content.size();
+                            queue.push(std::move(item));
+                            return true;
+                        });
+                    if (checkpoint && !stop_flag) checkpoint->registered(path_index);
+                } catch (const exception& e) {
+                    cerr << "\nError processing file " << path << ": " << e.what() << endl;
+                }
+                files_processed.fetch_add(1);
+            }
+            
+            // Cada lector mantiene abierto el ultimo archivo que leyo
+            unique_ptr<RangeReader> reader;
+            size_t current_file = SIZE_MAX;
+            size_t i;
+            while (!stop_flag && (i = next_task.fetch_add(1)) < tasks.size()) {
+                const ReadTask& task = tasks[i];
+                try {
+                    if (task.file != current_file) {
+                        reader = make_unique<RangeReader>(file_list[task.file].string());
+                        current_file = task.file;
+                    }
+                    if (!budget.acquire_queue(task.range.size(), stop_flag)) break;
+                    WorkItem item;
+                    item.doc_id = task.doc_id;
+                    item.accounted = task.range.size();
+                    reader->read(task.range, item.content);
+                    queue.push(std::move(item));
+                } catch (const exception& e) {
+                    cerr << "\nError processing file " << file_list[task.file] << ": " << e.what() << endl;
+                    current_file = SIZE_MAX;
+                }
+                if (task.last) files_processed.fetch_add(1);
+            }
+        });
+    }
+    for (auto& reader : readers) {
+        reader.join();
     }
+}
+
+// Tarea del planificador con robo de trabajo (--work-stealing)
+struct IndexTask {
+    enum Kind {
+        SMALL_FILES,  // Varios archivos pequeños, cada uno un documento completo
+        LARGE_FILE,   // Un archivo mayor que chunk_size que hay que dividir en rangos
+        FILE_RANGE    // Un rango de un archivo grande ya registrado como documento
+    };
+    Kind kind = SMALL_FILES;
+    vector<string> files;
+    uint32_t doc_id = 0;
+    ByteRange range;
+    shared_ptr<atomic<size_t>> remaining;  // Rangos del archivo aun sin procesar
 };
 
-void process_chunk(ThreadSafeQueue& queue, GlobalInvertedIndex& global_index, 
-    atomic<bool>& stop_flag) {
-    WorkItem item;
+// Los archivos pequeños se agrupan hasta estos limites para que cada tarea
+// tenga trabajo suficiente frente al coste de planificarla
+constexpr uint64_t SMALL_BATCH_BYTES = 1024 * 1024;
+constexpr size_t SMALL_BATCH_FILES = 64;
 
-    while (!stop_flag && queue.pop(item)) {
-        const string& chunk = item.content;
+// Recorre el directorio una sola vez mientras los workers ya procesan; los
+// totales para el progreso crecen a medida que se encuentran archivos
+void schedule_directory(const string& input_directory, size_t chunk_size,
+    WorkStealingDeques<IndexTask>& scheduler, atomic<uint64_t>& total_size,
+    atomic<size_t>& total_files, atomic<bool>& stop_flag, const IndexCheckpoint* checkpoint) {
+    IndexTask batch;
+    uint64_t batch_bytes = 0;
+    for (const auto& entry : fs::recursive_directory_iterator(input_directory)) {
+        if (stop_flag) break;
+        if (!entry.is_regular_file()) continue;
+        // Archivo ya indexado entero en el checkpoint (--resume)
+        if (checkpoint && checkpoint->is_complete(entry.path().string())) continue;
+        
+        uint64_t size = entry.file_size();
+        total_size.fetch_add(size);
+        total_files.fetch_add(1);
         
-        // Crear un identificador único para el documento basado en la ruta del archivo y el chunk_id
-        fs::path path(item.file_path);
-        string doc_id = path.filename().string() + "_chunk_" + to_string(item.chunk_id);
+        if (size > chunk_size) {
+            IndexTask task;
+            task.kind = IndexTask::LARGE_FILE;
+            task.files.push_back(entry.path().string());
+            scheduler.submit(std::move(task));
+            continue;
+        }
         
-        unordered_map<string, unordered_set<string>> local_index;
-        istringstream stream(chunk);
-        string word;
+        batch.files.push_back(entry.path().string());
+        batch_bytes += size;
+        if (batch_bytes >= SMALL_BATCH_BYTES || batch.files.size() >= SMALL_BATCH_FILES) {
+            scheduler.submit(std::move(batch));
+            batch = IndexTask();
+            batch_bytes = 0;
+        }
+    }
+    if (!batch.files.empty()) {
+        scheduler.submit(std::move(batch));
+    }
+}
+
+// Worker del planificador: lee los archivos el mismo con pread y los indexa.
+// Un archivo grande se divide en rangos (los mismos cortes que --mmap) que se
+// dejan en la cola propia, de donde los demas hilos pueden robarlos.
+void work_stealing_worker(WorkStealingDeques<IndexTask>& scheduler, size_t worker_id,
+    size_t chunk_size, DocumentTable& documents, GlobalInvertedIndex& global_index,
+    MemoryBudget& budget, atomic<bool>& stop_flag, atomic<size_t>& progress_bytes,
+    atomic<size_t>& files_processed, unsigned normalize, IndexCheckpoint* checkpoint) {
+    ChunkIndexer indexer(global_index, budget, normalize);
+    IndexTask task;
+    string buffer;
+    unique_ptr<RangeReader> reader;  // Ultimo archivo grande leido por este hilo
     
-        while (stream >> word) {
-            size_t start = 0, end = word.size();
-            while (start < end && ispunct(static_cast<unsigned char>(word[start]))) ++start;
-            
-            while (end > start && ispunct(static_cast<unsigned char>(word[end - 1]))) --end;
-            if (start < end) {
-                string clean_word = word.substr(start, end - start);
-                transform(clean_word.begin(), clean_word.end(), clean_word.begin(), ::tolower);
-                local_index[clean_word].insert(doc_id);
+    // Un archivo comprimido no se puede dividir en rangos: este hilo lo descomprime
+    // e indexa entero, sea cual sea su tamaño
+    auto index_compressed = [&](const string& path) {
+        uint32_t path_index = read_compressed_file(path, chunk_size, 1, documents, [&](uint32_t doc_id, string&& text) {
+            indexer.index(text, doc_id);
+            progress_bytes.fetch_add(text.size());
+            return !stop_flag;
+        });
+        if (checkpoint && !stop_flag) checkpoint->registered(path_index);
+    };
+    
+    while (scheduler.pop(worker_id, task)) {
+        if (stop_flag) continue;  // Vaciar las colas sin procesar
+        
+        if (task.kind == IndexTask::SMALL_FILES) {
+            for (const auto& path : task.files) {
+                try {
+                    if (detect_compression_file(path) != Compression::NONE) {
+                        index_compressed(path);
+                        files_processed.fetch_add(1);
+                        continue;
+                    }
+                    RangeReader file(path);
+                    file.read({0, file.size()}, buffer);
+                    if (!buffer.empty()) {
+                        uint32_t path_index = documents.add_path(path);
+                        uint32_t doc_id = documents.add(path_index, 0, 0);
+                        indexer.index(buffer, doc_id);
+                        progress_bytes.fetch_add(buffer.size());
+                        if (checkpoint) checkpoint->registered(path_index);
+                    }
+                } catch (const exception& e) {
+                    cerr << "\nError processing file " << path << ": " << e.what() << endl;
+                }
+                files_processed.fetch_add(1);
             }
+            continue;
         }
         
-        global_index.merge(local_index);
+        const string& path = task.files[0];
+        try {
+            if (task.kind == IndexTask::LARGE_FILE && detect_compression_file(path) != Compression::NONE) {
+                index_compressed(path);
+                files_processed.fetch_add(1);
+                continue;
+            }
+            if (task.kind == IndexTask::LARGE_FILE) {
+                RangeReader file(path);
+                uint32_t path_index = documents.add_path(path);
+                vector<ByteRange> ranges = file.split(chunk_size);
+                
+                // Con --resume los rangos ya indexados no se vuelven a leer
+                vector<uint32_t> doc_ids;
+                vector<size_t> pending;
+                for (uint32_t c = 0; c < ranges.size(); ++c) {
+                    doc_ids.push_back(documents.add(path_index, c, ranges[c].begin));
+                    if (!global_index.already_indexed(doc_ids.back())) pending.push_back(c);
+                }
+                if (checkpoint) checkpoint->registered(path_index);
+                if (pending.empty()) files_processed.fetch_add(1);
+                auto remaining = make_shared<atomic<size_t>>(pending.size());
+                // En orden inverso: el hilo duenio saca del final y recorre el archivo
+                // hacia adelante, los ladrones se llevan los ultimos rangos
+                for (size_t i = pending.size(); i-- > 0;) {
+                    size_t c = pending[i];
+                    IndexTask range_task;
+                    range_task.kind = IndexTask::FILE_RANGE;
+                    range_task.files.push_back(path);
+                    range_task.doc_id = doc_ids[c];
+                    range_task.range = ranges[c];
+                    range_task.remaining = remaining;
+                    scheduler.push(worker_id, std::move(range_task));
+                }
+                continue;
+            }
+            
+            if (!reader || reader->get_path() != path) {
+                reader = make_unique<RangeReader>(path);
+            }
+            reader->read(task.range, buffer);
+            indexer.index(buffer, task.doc_id);
+            progress_bytes.fetch_add(buffer.size());
+        } catch (const exception& e) {
+            cerr << "\nError processing file " << path << ": " << e.what() << endl;
+            reader.reset();
+        }
+        if (task.kind == IndexTask::FILE_RANGE && task.remaining->fetch_sub(1) == 1) {
+            files_processed.fetch_add(1);
+        }
     }
 }
 
+// Actualizacion de un indice incremental (--incremental): compara el directorio
+// de entrada con el manifiesto, lanza en segundo plano las fusiones que pide la
+// politica por niveles y al final registra el segmento con los archivos nuevos y
+// guarda el manifiesto. Las fusiones solo leen segmentos ya escritos, asi que
+// avanzan a la vez que se indexa.
+class IncrementalUpdate {
+private:
+    IndexManifest manifest;
+    vector<fs::path> changed;                    // Archivos nuevos o modificados
+    vector<IndexManifest::File> changed_entries; // Su tamaño y mtime
+    string segment_name;
+    vector<vector<string>> merge_groups;
+    vector<string> merge_outputs;
+    vector<uint64_t> merge_docs;
+    vector<string> merge_errors;
+    thread merger;
+    bool committed = false;
+
+public:
+    size_t new_files = 0;
+    size_t modified_files = 0;
+    size_t removed_files = 0;
+    size_t unchanged_files = 0;
+
+    explicit IncrementalUpdate(const string& index_directory) : manifest(index_directory) {}
+
+    ~IncrementalUpdate() {
+        if (merger.joinable()) merger.join();
+        if (committed) return;
+        // Sin manifiesto nuevo los segmentos escritos en esta ejecucion sobran
+        error_code error;
+        if (!segment_name.empty()) fs::remove(manifest.segment_path(segment_name), error);
+        for (const auto& output : merge_outputs) {
+            fs::remove(manifest.segment_path(output), error);
+        }
+    }
+
+    IndexManifest& get_manifest() {
+        return manifest;
+    }
+
+    const vector<fs::path>& files() const {
+        return changed;
+    }
+
+    // Un archivo se vuelve a indexar si su tamaño o su mtime no coinciden con el
+    // manifiesto; en ese caso, y si ya no existe, su version anterior queda con
+    // tombstone en su segmento
+    void scan(const string& input_directory, atomic<uint64_t>& total_size, atomic<size_t>& total_files) {
+        unordered_set<string> present;
+        for (const auto& entry : fs::recursive_directory_iterator(input_directory)) {
+            if (!entry.is_regular_file()) continue;
+            string path = entry.path().string();
+            present.insert(path);
+            IndexManifest::File file;
+            file.size = entry.file_size();
+            file.mtime = static_cast<int64_t>(entry.last_write_time().time_since_epoch().count());
+            const IndexManifest::File* known = manifest.find_file(path);
+            if (known && known->size == file.size && known->mtime == file.mtime) {
+                unchanged_files++;
+                continue;
+            }
+            if (known) {
+                manifest.remove_file(path);
+                modified_files++;
+            } else {
+                new_files++;
+            }
+            changed.push_back(entry.path());
+            changed_entries.push_back(file);
+            total_size += file.size;
+            total_files++;
+        }
+        vector<string> removed;
+        for (const auto& entry : manifest.get_files()) {
+            if (!present.count(entry.first)) removed.push_back(entry.first);
+        }
+        for (const auto& path : removed) {
+            manifest.remove_file(path);
+        }
+        removed_files = removed.size();
+    }
+
+    void start_merges(size_t merge_factor) {
+        segment_name = manifest.new_segment_name();
+        merge_groups = plan_merges(manifest, merge_factor);
+        for (size_t i = 0; i < merge_groups.size(); ++i) {
+            merge_outputs.push_back(manifest.new_segment_name());
+        }
+        merge_docs.assign(merge_groups.size(), 0);
+        merge_errors.assign(merge_groups.size(), "");
+        if (merge_groups.empty()) return;
+        merger = thread([this]() {
+            for (size_t i = 0; i < merge_groups.size(); ++i) {
+                try {
+                    merge_docs[i] = merge_segments(manifest, merge_groups[i], manifest.segment_path(merge_outputs[i]));
+                } catch (const exception& e) {
+                    merge_errors[i] = e.what();
+                }
+            }
+        });
+    }
+
+    size_t pending_merges() const {
+        return merge_groups.size();
+    }
+
+    // Escribe el segmento nuevo (si hay documentos), aplica las fusiones que
+    // terminaron bien y guarda el manifiesto. Los segmentos fusionados solo se
+    // borran despues de guardarlo. El checkpoint se borra antes: reanudar despues
+    // de guardar el manifiesto volveria a añadir el segmento.
+    bool commit(GlobalInvertedIndex& global_index, const DocumentTable& documents, IndexCheckpoint* checkpoint) {
+        if (merger.joinable()) merger.join();
+
+        if (documents.size() > 0) {
+            string path = manifest.segment_path(segment_name);
+            cout << "\nWriting segment " << path << "..." << endl;
+            if (!global_index.write_to_file(path, false)) return false;
+            manifest.add_segment({segment_name, documents.size(), fs::file_size(path)});
+        }
+
+        unordered_map<string, uint64_t> docs_per_path;
+        for (uint32_t doc = 0; doc < documents.size(); ++doc) {
+            docs_per_path[documents.path(doc)]++;
+        }
+        for (size_t i = 0; i < changed.size(); ++i) {
+            IndexManifest::File entry = changed_entries[i];
+            auto it = docs_per_path.find(changed[i].string());
+            entry.docs = it == docs_per_path.end() ? 0 : it->second;
+            // Un archivo no vacio sin documentos no se pudo leer: se reintenta la proxima vez
+            if (entry.docs == 0 && entry.size > 0) continue;
+            entry.segment = entry.docs > 0 ? segment_name : IndexManifest::NO_SEGMENT;
+            manifest.add_file(changed[i].string(), entry);
+        }
+
+        vector<string> obsolete;
+        for (size_t i = 0; i < merge_groups.size(); ++i) {
+            string path = manifest.segment_path(merge_outputs[i]);
+            if (!merge_errors[i].empty()) {
+                cerr << "Failed to merge segments: " << merge_errors[i] << endl;
+                obsolete.push_back(merge_outputs[i]);
+                continue;
+            }
+            manifest.replace_segments(merge_groups[i], {merge_outputs[i], merge_docs[i], fs::file_size(path)});
+            if (merge_docs[i] == 0) obsolete.push_back(merge_outputs[i]);
+            obsolete.insert(obsolete.end(), merge_groups[i].begin(), merge_groups[i].end());
+            cout << "Merged " << merge_groups[i].size() << " segments into " << merge_outputs[i]
+                 << " (" << merge_docs[i] << " documents)" << endl;
+        }
+
+        if (checkpoint) checkpoint->finish();
+        manifest.save();
+        committed = true;
+        error_code error;
+        for (const auto& name : obsolete) {
+            fs::remove(manifest.segment_path(name), error);
+        }
+        return true;
+    }
+};
+
 // HELPERS OF OUTPUT
 string format_bytes(uint64_t bytes) {
     const char* suffixes[] = {"B", "KB", "MB", "GB", "TB"};
@@ -351,22 +1261,60 @@ string format_number(uint64_t num) {
 
 
 int main(int argc, char* argv[]) {
-    if (argc < 3) {
-        cerr << "Usage: " << argv[0] << " <input_directory> <output_file> [chunk_size_MB] [num_threads] [max_memory_words]" << endl;
+    CommandLine args(argc, argv);
+    if (args.positional.size() < 2) {
+        cerr << "Usage: " << argv[0] << " <input_directory> <output_file> [chunk_size_MB] [num_threads] [max_memory_words] [--mmap] [--normalize=MODE] [--text] [--memory-budget=SIZE] [--queue-chunks=N] [--readers=N] [--work-stealing] [--async-io[=uring|threads]] [--io-depth=N] [--direct] [--decode-threads=N] [--positions] [--incremental] [--merge-factor=N] [--checkpoint-interval=SECONDS] [--resume]" << endl;
         return 1;
     }
     
-    string input_directory = argv[1];
-    string output_file = argv[2];
+    string input_directory = args.positional[0];
+    string output_file = args.positional[1];
     
     // Default values
-    size_t chunk_size_mb = (argc > 3) ? stoul(argv[3]) : 100; // Default 100MB
+    size_t chunk_size_mb = (args.positional.size() > 2) ? stoul(args.positional[2]) : 100; // Default 100MB
     size_t chunk_size = chunk_size_mb * 1024 * 1024;
     
-    size_t num_threads = (argc > 4) ? stoul(argv[4]) : thread::hardware_concurrency();
+    size_t num_threads = (args.positional.size() > 3) ? stoul(args.positional[3]) : thread::hardware_concurrency();
     if (num_threads == 0) num_threads = 4; // Fallback if hardware_concurrency returns 0
     
-    size_t max_memory_words = (argc > 5) ? stoul(argv[5]) : 5000;
+    // Limite opcional de terminos en memoria; por defecto decide solo el presupuesto en bytes
+    size_t max_memory_words = (args.positional.size() > 4) ? stoul(args.positional[4]) : SIZE_MAX;
+    bool use_mmap = args.has("mmap");
+    unsigned normalize = parse_normalize_mode(args.get("normalize"));
+    bool text_output = args.has("text");
+    // Guarda la posicion de cada palabra para las consultas de frase (solo en el segmento binario)
+    bool with_positions = args.has("positions") && !text_output;
+    // output_file es el directorio de un indice por segmentos y solo se indexan los
+    // archivos nuevos o modificados desde la ultima ejecucion
+    bool incremental = args.has("incremental");
+    // Segmentos de un mismo nivel que se juntan antes de fusionarlos
+    size_t merge_factor = max<size_t>(2, stoul(args.get("merge-factor", "10")));
+    if (incremental && text_output) {
+        cerr << "--incremental writes binary segments and cannot be combined with --text" << endl;
+        return 1;
+    }
+    size_t memory_budget = parse_byte_size(args.get("memory-budget", "4G"));
+    // Chunks que pueden esperar en la cola; el presupuesto limita ademas sus bytes
+    size_t queue_chunks = stoul(args.get("queue-chunks", to_string(2 * num_threads)));
+    // Con mas de un lector los archivos se cortan en rangos que se leen en paralelo con pread
+    size_t num_readers = use_mmap ? 1 : max<size_t>(1, stoul(args.get("readers", "1")));
+    // Los workers recorren y leen los archivos ellos mismos con colas por hilo y robo de
+    // trabajo (no en modo incremental, que indexa una lista de archivos)
+    bool work_stealing = args.has("work-stealing") && !incremental;
+    // Lectura asincrona con varias lecturas en vuelo (solo con un lector y sin --mmap)
+    bool async_io = args.has("async-io") && !use_mmap && num_readers == 1 && !work_stealing;
+    size_t io_depth = max<size_t>(1, stoul(args.get("io-depth", "2")));
+    bool direct_io = args.has("direct");
+    // Hilos para descomprimir un archivo formado por frames independientes
+    size_t decode_threads = stoul(args.get("decode-threads", to_string(max<size_t>(1, num_threads / 2))));
+    // Checkpoint cada N segundos (ademas de en cada volcado) en <output_file>.checkpoint y
+    // reanudacion desde el ultimo; con --resume sin intervalo solo hay checkpoints en los volcados
+    size_t checkpoint_interval = stoul(args.get("checkpoint-interval", "0"));
+    bool resume = args.has("resume");
+    bool checkpointing = checkpoint_interval > 0 || resume;
+    string checkpoint_dir = output_file;
+    while (checkpoint_dir.size() > 1 && checkpoint_dir.back() == '/') checkpoint_dir.pop_back();
+    checkpoint_dir += ".checkpoint";
     
     // Verificar que el directorio existe
     if (!fs::exists(input_directory) || !fs::is_directory(input_directory)) {
@@ -374,26 +1322,74 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
-    // Crear directorio temporal para archivos intermedios
+    // Crear directorio temporal para archivos intermedios. Con checkpoints los runs
+    // van al directorio del checkpoint, que no se borra si hay un error.
     string temp_dir = fs::temp_directory_path().string() + "/index_temp_" + to_string(chrono::system_clock::now().time_since_epoch().count());
-    try {
-        fs::create_directories(temp_dir);
-    } catch (const exception& e) {
-        cerr << "Failed to create temp directory: " << e.what() << endl;
-        temp_dir = fs::path(output_file).parent_path().string() + "/temp_files";
+    if (checkpointing) {
+        temp_dir = checkpoint_dir;
+    } else {
         try {
             fs::create_directories(temp_dir);
-        } catch (...) {
-            temp_dir = "."; // Usar directorio actual como último recurso
+        } catch (const exception& e) {
+            cerr << "Failed to create temp directory: " << e.what() << endl;
+            temp_dir = fs::path(output_file).parent_path().string() + "/temp_files";
+            try {
+                fs::create_directories(temp_dir);
+            } catch (...) {
+                temp_dir = "."; // Usar directorio actual como último recurso
+            }
+        }
+    }
+    
+    // Calcular el tamaño total de todos los archivos en el directorio. Con
+    // --work-stealing se cuentan durante el unico recorrido, en paralelo al indexado
+    atomic<uint64_t> total_size(0);
+    atomic<size_t> total_files(0);
+    
+    // En modo incremental solo cuentan los archivos que hay que indexar. Las rutas
+    // se guardan en el manifiesto, asi que se usa siempre la ruta absoluta.
+    unique_ptr<IncrementalUpdate> update;
+    if (incremental) {
+        try {
+            fs::path directory = fs::absolute(input_directory).lexically_normal();
+            if (!directory.has_filename()) directory = directory.parent_path();
+            input_directory = directory.string();
+            fs::create_directories(output_file);
+            update = make_unique<IncrementalUpdate>(output_file);
+            IndexManifest& manifest = update->get_manifest();
+            // El primer segmento decide si el indice guarda posiciones
+            if (manifest.segments().empty()) {
+                manifest.set_positional(with_positions);
+            } else {
+                with_positions = manifest.get_positional();
+            }
+            update->scan(input_directory, total_size, total_files);
+        } catch (const exception& e) {
+            cerr << "Error opening incremental index: " << e.what() << endl;
+            return 1;
         }
     }
     
-    // Calcular el tamaño total de todos los archivos en el directorio
-    uint64_t total_size = 0;
-    size_t total_files = 0;
+    // Los ids de documento del checkpoint solo valen con la misma entrada y los mismos cortes
+    unique_ptr<IndexCheckpoint> checkpoint;
+    if (checkpointing) {
+        string input_mode = work_stealing ? "work-stealing" : use_mmap ? "mmap" :
+                            num_readers > 1 ? "pread" : async_io ? "async" : "stream";
+        CheckpointFile options;
+        options.set("options", {to_string(chunk_size), to_string(normalize), with_positions ? "1" : "0",
+                                text_output ? "1" : "0", input_mode, input_directory});
+        try {
+            if (!resume) fs::remove_all(checkpoint_dir);
+            checkpoint = make_unique<IndexCheckpoint>(checkpoint_dir, options, checkpoint_interval);
+        } catch (const exception& e) {
+            cerr << "Failed to create checkpoint directory: " << e.what() << endl;
+            return 1;
+        }
+    }
     
     try {
         for (const auto& entry : fs::recursive_directory_iterator(input_directory)) {
+            if (work_stealing || incremental) break;
             if (fs::is_regular_file(entry)) {
                 total_size += fs::file_size(entry);
                 total_files++;
@@ -405,29 +1401,90 @@ int main(int argc, char* argv[]) {
     }
     
     cout << "Processing directory: " << input_directory << endl;
-    cout << "Total files found: " << total_files << endl;
-    cout << "Total size: " << format_bytes(total_size) << endl;
+    if (!work_stealing) {
+        cout << "Total files found: " << total_files << endl;
+        cout << "Total size: " << format_bytes(total_size) << endl;
+    }
     cout << "Chunk size: " << format_bytes(chunk_size) << endl;
     cout << "Using " << num_threads << " threads" << endl;
-    cout << "Max words in memory: " << format_number(max_memory_words) << endl;
+    cout << "Memory budget: " << format_bytes(memory_budget) << endl;
+    cout << "Queue capacity: " << queue_chunks << " chunks" << endl;
+    if (max_memory_words != SIZE_MAX) {
+        cout << "Max words in memory: " << format_number(max_memory_words) << endl;
+    }
     cout << "Temporary directory: " << temp_dir << endl;
+    if (work_stealing) {
+        cout << "Input mode: work-stealing (workers read with pread)" << endl;
+    } else if (use_mmap) {
+        cout << "Input mode: mmap (zero-copy)" << endl;
+    } else if (num_readers > 1) {
+        cout << "Input mode: pread (" << num_readers << " parallel readers)" << endl;
+    } else {
+        cout << "Input mode: stream" << endl;
+    }
+    cout << "Tokenizer kernel: " << kernel_name(best_kernel()) << endl;
+    cout << "Normalization: " << normalize_mode_name(normalize) << endl;
+    cout << "Output format: " << (text_output ? "text" : "binary segment")
+         << (with_positions ? " with positions" : "") << endl;
+    if (update) {
+        cout << "Incremental index: " << output_file << " ("
+             << update->get_manifest().segments().size() << " segments) - "
+             << update->new_files << " new, " << update->modified_files << " modified, "
+             << update->removed_files << " removed, " << update->unchanged_files << " unchanged files" << endl;
+    }
+    if (checkpoint) {
+        cout << "Checkpoints: " << checkpoint_dir;
+        if (checkpoint_interval > 0) cout << " every " << checkpoint_interval << "s and";
+        cout << " on every flush" << endl;
+    }
     
     auto start_time = chrono::high_resolution_clock::now();
     
-    ThreadSafeQueue chunk_queue;
-    GlobalInvertedIndex global_index(max_memory_words, temp_dir);
+    WorkQueue chunk_queue(queue_chunks);
+    DocumentTable documents;
+    MemoryBudget budget(memory_budget);
+    GlobalInvertedIndex global_index(documents, budget, max_memory_words, temp_dir, with_positions);
     atomic<bool> stop_flag(false);
     atomic<size_t> progress_bytes(0);
     atomic<size_t> total_files_processed(0);
+    WorkStealingDeques<IndexTask> scheduler(num_threads);
+    
+    // Con --resume la tabla de documentos y los runs salen del ultimo checkpoint
+    if (checkpoint) {
+        try {
+            if (resume && checkpoint->load(documents)) {
+                cout << "Resuming: " << checkpoint->indexed_documents().size() << " documents in "
+                     << checkpoint->runs().size() << " runs already indexed" << endl;
+            } else if (resume) {
+                cout << "No checkpoint found, starting from the beginning" << endl;
+            }
+        } catch (const exception& e) {
+            cerr << "Cannot resume: " << e.what() << endl;
+            return 1;
+        }
+        global_index.enable_checkpoints(*checkpoint);
+    }
+    global_index.stop_on_failure(stop_flag);
     
     // Crear hilos para procesar chunks
     vector<thread> processing_threads;
     for (size_t i = 0; i < num_threads; ++i) {
-        processing_threads.emplace_back(process_chunk, ref(chunk_queue), ref(global_index), ref(stop_flag));
+        if (work_stealing) {
+            processing_threads.emplace_back(work_stealing_worker, ref(scheduler), i, chunk_size, ref(documents),
+                                            ref(global_index), ref(budget), ref(stop_flag), ref(progress_bytes),
+                                            ref(total_files_processed), normalize, checkpoint.get());
+        } else {
+            processing_threads.emplace_back(process_chunk, ref(chunk_queue), ref(global_index), ref(budget), ref(stop_flag), ref(progress_bytes), normalize);
+        }
     }
     
-    // Limitar la cola para evitar uso excesivo de memoria
-    const size_t max_queue_size = 50;  // Ajustar según necesidades
+    // Las fusiones de segmentos avanzan en segundo plano mientras se indexa
+    if (update) {
+        update->start_merges(merge_factor);
+        if (update->pending_merges() > 0) {
+            cout << "Merging " << update->pending_merges() << " segment groups in the background" << endl;
+        }
+    }
     
     // Hilo para mostrar progreso
     thread progress_thread([&]() {
@@ -444,6 +1501,7 @@ int main(int argc, char* argv[]) {
                      << speed_mbps << " MB/s - "
                      << "Files: " << total_files_processed << "/" << total_files << " - "
                      << "Words: " << format_number(global_index.get_total_words()) << " - "
+                     << "Mem: " << format_bytes(budget.total()) << " - "
                      << "Time: " << elapsed << "s" << flush;
             }
             
@@ -455,85 +1513,178 @@ int main(int argc, char* argv[]) {
         // Leer archivos secuencialmente para evitar sobrecarga de memoria
         vector<fs::path> file_list;
         
-        // Recopilar todos los archivos regulares
-        for (const auto& entry : fs::recursive_directory_iterator(input_directory)) {
-            if (fs::is_regular_file(entry)) {
-                file_list.push_back(entry.path());
-            }
+        // Un solo motor de E/S para todos los archivos (un anillo de io_uring o un grupo de hilos)
+        unique_ptr<IoEngine> io_engine;
+        if (async_io) {
+            io_engine = make_io_engine(args.get("async-io"), io_depth);
+            cout << "Async I/O: " << io_engine->name() << ", " << io_depth << " reads in flight"
+                 << (direct_io ? ", O_DIRECT if supported" : "") << endl;
         }
         
         cout << "\nStarting file processing..." << endl;
         
-        for (const auto& file_path : file_list) {
-            if (stop_flag) break;
-            
-            try {
-                // Procesar archivo en lotes de chunks
-                ifstream file(file_path, ios::binary);
-                if (!file.is_open()) {
-                    cerr << "\nFailed to open input file: " << file_path << endl;
+        if (work_stealing) {
+            // Solo se recorre el directorio; los workers leen los archivos y file_list queda vacia
+            schedule_directory(input_directory, chunk_size, scheduler, total_size, total_files, stop_flag, checkpoint.get());
+            scheduler.close();
+        } else if (update) {
+            file_list = update->files();
+        } else {
+            // Recopilar todos los archivos regulares
+            for (const auto& entry : fs::recursive_directory_iterator(input_directory)) {
+                if (fs::is_regular_file(entry)) {
+                    file_list.push_back(entry.path());
+                }
+            }
+        }
+        
+        // Los archivos que ya estaban enteros en el checkpoint no se vuelven a leer
+        if (checkpoint) {
+            vector<fs::path> pending;
+            for (const auto& file_path : file_list) {
+                if (!checkpoint->is_complete(file_path.string())) {
+                    pending.push_back(file_path);
                     continue;
                 }
-                
-                auto file_size = fs::file_size(file_path);
-                vector<char> buffer;
-                buffer.reserve(chunk_size + 1024);
-                
-                size_t chunk_id = 0;
-                string leftover;
-                
-                while (file && !stop_flag) {
-                    // Control de flujo básico para evitar sobrecargar la cola
-                    while (chunk_queue.size() > max_queue_size && !stop_flag) {
-                        this_thread::sleep_for(chrono::milliseconds(100));
+                error_code error;
+                uint64_t size = fs::file_size(file_path, error);
+                if (!error) progress_bytes += size;
+                total_files_processed++;
+            }
+            file_list.swap(pending);
+        }
+        
+        if (num_readers > 1) {
+            read_files_parallel(file_list, chunk_size, num_readers, documents, chunk_queue,
+                                budget, stop_flag, total_files_processed, checkpoint.get());
+        } else {
+            for (const auto& file_path : file_list) {
+                if (stop_flag) break;
+            
+                try {
+                    // Los archivos comprimidos (por bytes magicos) se descomprimen en streaming
+                    if (detect_compression_file(file_path.string()) != Compression::NONE) {
+                        uint32_t path_index = read_compressed_file(file_path.string(), chunk_size, decode_threads, documents,
+                            [&](uint32_t doc_id, string&& text) {
+                                if (!budget.acquire_queue(text.size(), stop_flag)) return false;
+                                WorkItem item(doc_id, std::move(text));
+                                item.accounted = item.content.size();
+                                chunk_queue.push(std::move(item));
+                                return true;
+                            });
+                        if (checkpoint && !stop_flag) checkpoint->registered(path_index);
+                        total_files_processed.fetch_add(1);
+                        continue;
                     }
                     
-                    buffer.resize(chunk_size + 1);
-                    file.read(buffer.data(), chunk_size + 1);
-                    streamsize bytes_read = file.gcount();
+                    if (use_mmap) {
+                        // El mapeo se comparte entre todos los chunks del archivo y se
+                        // libera cuando el ultimo hilo termina de procesarlo
+                        auto mapping = make_shared<const MappedFile>(file_path.string());
+                        uint32_t path_index = documents.add_path(file_path.string());
+                        uint32_t chunk_id = 0;
+                        split_at_whitespace(mapping->view(), chunk_size, [&](string_view slice) {
+                            uint64_t offset = static_cast<uint64_t>(slice.data() - mapping->view().data());
+                            uint32_t doc_id = documents.add(path_index, chunk_id++, offset);
+                            if (global_index.already_indexed(doc_id)) return;
+                            chunk_queue.push(WorkItem(doc_id, slice, mapping));  // Bloquea si la cola esta llena
+                        });
+                        if (checkpoint) checkpoint->registered(path_index);
+                        total_files_processed.fetch_add(1);
+                        continue;
+                    }
+                
+                    if (io_engine) {
+                        // Mientras los hilos procesan un chunk ya hay io_depth lecturas en curso;
+                        // el buffer leido pasa al WorkItem sin copiarse
+                        AsyncFileReader reader(*io_engine, file_path.string(), chunk_size, io_depth, direct_io);
+                        uint32_t path_index = documents.add_path(file_path.string());
+                        uint32_t chunk_id = 0;
+                        ReadBlock block;
+                        while (!stop_flag && reader.next(block)) {
+                            if (!budget.acquire_queue(block.size(), stop_flag)) break;
+                            WorkItem item;
+                            item.doc_id = documents.add(path_index, chunk_id++, block.file_offset);
+                            item.accounted = block.size();
+                            item.block = std::move(block);
+                            chunk_queue.push(std::move(item));
+                        }
+                        if (checkpoint && !stop_flag) checkpoint->registered(path_index);
+                        total_files_processed.fetch_add(1);
+                        continue;
+                    }
                     
-                    if (bytes_read <= 0) break;
+                    // Procesar archivo en lotes de chunks
+                    ifstream file(file_path, ios::binary);
+                    if (!file.is_open()) {
+                        cerr << "\nFailed to open input file: " << file_path << endl;
+                        continue;
+                    }
+                
+                    vector<char> buffer;
+                    buffer.reserve(chunk_size + 1024);
+                
+                    uint32_t path_index = documents.add_path(file_path.string());
+                    uint32_t chunk_id = 0;
+                    uint64_t offset = 0;  // Byte del archivo donde empieza el proximo chunk
+                    string leftover;
+                
+                    while (file && !stop_flag) {
+                        buffer.resize(chunk_size + 1);
+                        file.read(buffer.data(), chunk_size + 1);
+                        streamsize bytes_read = file.gcount();
                     
-                    // Actualizar bytes procesados
-                    progress_bytes.fetch_add(bytes_read);
+                        if (bytes_read <= 0) break;
                     
-                    // Convertir a string
-                    string chunk(buffer.data(), bytes_read);
+                        // Convertir a string
+                        string chunk(buffer.data(), bytes_read);
                     
-                    // Añadir leftover anterior si hay
-                    if (!leftover.empty()) {
-                        chunk = leftover + chunk;
-                        leftover.clear();
-                    }
+                        // Añadir leftover anterior si hay
+                        if (!leftover.empty()) {
+                            chunk = leftover + chunk;
+                            leftover.clear();
+                        }
                     
-                    // Si leímos exactamente chunk_size + 1, verificamos el último carácter
-                    if (bytes_read == static_cast<streamsize>(chunk_size + 1)) {
-                        if (!isspace(chunk.back())) {
-                            size_t last_space = chunk.find_last_of(" \t\n\r");
-                            if (last_space != string::npos) {
-                                leftover = chunk.substr(last_space + 1);
-                                chunk.resize(last_space + 1);
+                        // Si leímos exactamente chunk_size + 1, verificamos el último carácter
+                        if (bytes_read == static_cast<streamsize>(chunk_size + 1)) {
+                            if (!isspace(chunk.back())) {
+                                size_t last_space = chunk.find_last_of(" \t\n\r");
+                                if (last_space != string::npos) {
+                                    leftover = chunk.substr(last_space + 1);
+                                    chunk.resize(last_space + 1);
+                                }
                             }
                         }
-                    }
                     
-                    chunk_queue.push(WorkItem(file_path.string(), chunk_id++, chunk));
-                }
+                        // Backpressure: espera a que la cola vuelva a caber en el presupuesto
+                        if (!budget.acquire_queue(chunk.size(), stop_flag)) break;
+                    
+                        uint32_t doc_id = documents.add(path_index, chunk_id++, offset);
+                        offset += chunk.size();
+                        WorkItem item(doc_id, std::move(chunk));
+                        item.accounted = item.content.size();
+                        chunk_queue.push(std::move(item));
+                    }
                 
-                // Handle any remaining leftover
-                if (!leftover.empty() && !stop_flag) {
-                    chunk_queue.push(WorkItem(file_path.string(), chunk_id++, leftover));
-                }
+                    // Handle any remaining leftover
+                    if (!leftover.empty() && budget.acquire_queue(leftover.size(), stop_flag)) {
+                        uint32_t doc_id = documents.add(path_index, chunk_id++, offset);
+                        WorkItem item(doc_id, std::move(leftover));
+                        item.accounted = item.content.size();
+                        chunk_queue.push(std::move(item));
+                    }
                 
-                total_files_processed.fetch_add(1);
+                    if (checkpoint && !stop_flag) checkpoint->registered(path_index);
+                    total_files_processed.fetch_add(1);
                 
-            } catch (const exception& e) {
-                cerr << "\nError processing file " << file_path << ": " << e.what() << endl;
+                } catch (const exception& e) {
+                    cerr << "\nError processing file " << file_path << ": " << e.what() << endl;
+                }
             }
         }
         
         // Señalar que hemos terminado de leer todos los archivos
-        chunk_queue.finish();
+        chunk_queue.close();
         
         // Esperar a que terminen todos los workers
         for (auto& thread : processing_threads) {
@@ -546,17 +1697,34 @@ int main(int argc, char* argv[]) {
             progress_thread.join();
         }
         
+        // Con un volcado fallido los runs no tienen todos los documentos
+        if (global_index.failed()) {
+            throw runtime_error("Index is incomplete: " + global_index.failure());
+        }
+        
         // Escribir resultados finales
-        cout << "\nWriting final results to " << output_file << "..." << endl;
-        global_index.write_to_file(output_file);
+        if (update) {
+            if (!update->commit(global_index, documents, checkpoint.get())) {
+                throw runtime_error("Incremental index was not updated");
+            }
+            cout << "Segments: " << update->get_manifest().segments().size() << endl;
+        } else {
+            cout << "\nWriting final results to " << output_file << "..." << endl;
+            // Si la salida no se pudo escribir el checkpoint se conserva para reintentar
+            if (!global_index.write_to_file(output_file, text_output)) {
+                throw runtime_error("Output file was not written");
+            }
+            if (checkpoint) checkpoint->finish();
+        }
         
-        fs::remove_all(temp_dir);
+        if (!checkpointing) fs::remove_all(temp_dir);
         
         auto end_time = chrono::high_resolution_clock::now();
         auto duration = chrono::duration_cast<chrono::seconds>(end_time - start_time).count();
         
         cout << "\nProcessing complete!" << endl;
         cout << "Total unique words indexed: " << global_index.get_total_words() << endl;
+        cout << "Unique words (HyperLogLog): " << global_index.estimate_unique_terms() << endl;
         cout << "Total time: " << duration << " seconds" << endl;
         
     } catch (const exception& e) {
@@ -568,12 +1736,14 @@ int main(int argc, char* argv[]) {
         }
         
         // Esperar a que terminen todos los workers
-        chunk_queue.finish();
+        chunk_queue.close();
+        scheduler.close();
         for (auto& thread : processing_threads) {
             if (thread.joinable()) thread.join();
         }
         
-        fs::remove_all(temp_dir);
+        // Los runs del checkpoint se conservan para --resume
+        if (!checkpointing) fs::remove_all(temp_dir);
         
         return 1;
     }
@@ -0,0 +1,362 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "indexSegment.hpp"
+
+// ---------------------------------------------------------------------------
+// Indice incremental (index --incremental): un directorio con varios segmentos
+// y un MANIFEST de texto con los segmentos que forman el indice, el segmento de
+// cada archivo de entrada (con su tamaño y mtime para detectar cambios) y los
+// archivos borrados de cada segmento (tombstones).
+//
+//   BDWMANIFEST  1
+//   positions    0 o 1 (todos los segmentos se construyen igual)
+//   next         numero del proximo segmento
+//   segment      nombre  docs  bytes
+//   file         segmento  docs  tamaño  mtime  ruta
+//   deleted      segmento  docs  ruta
+//
+// Los campos van separados por tabuladores y la ruta es siempre el ultimo. Un
+// archivo que no genero documentos tiene el segmento "-". El manifiesto se
+// escribe entero en un archivo temporal que se renombra encima del anterior, asi
+// que un corte a mitad deja el indice como estaba; los segmentos que ya no
+// aparecen en el se borran despues.
+// ---------------------------------------------------------------------------
+
+class IndexManifest {
+public:
+    static constexpr const char* FILE_NAME = "MANIFEST";
+    static constexpr const char* NO_SEGMENT = "-";
+
+    struct Segment {
+        std::string name;
+        uint64_t docs = 0;   // Documentos del segmento, incluidos los borrados
+        uint64_t bytes = 0;
+    };
+
+    struct File {
+        std::string segment = NO_SEGMENT;
+        uint64_t docs = 0;
+        uint64_t size = 0;
+        int64_t mtime = 0;
+    };
+
+    struct Tombstone {
+        std::string segment;
+        uint64_t docs = 0;
+        std::string path;
+    };
+
+private:
+    std::string directory;
+    bool positional = false;
+    uint64_t next_segment = 1;
+    std::vector<Segment> segment_list;
+    std::map<std::string, File> files;
+    std::vector<Tombstone> tombstones;
+
+    static std::vector<std::string> split_fields(const std::string& line, size_t count) {
+        std::vector<std::string> fields;
+        size_t start = 0;
+        while (fields.size() + 1 < count) {
+            size_t tab = line.find('\t', start);
+            if (tab == std::string::npos) break;
+            fields.push_back(line.substr(start, tab - start));
+            start = tab + 1;
+        }
+        fields.push_back(line.substr(start));
+        return fields;
+    }
+
+    void load(const std::string& path) {
+        std::ifstream in(path);
+        std::string line;
+        if (!std::getline(in, line) || line != "BDWMANIFEST\t1") {
+            throw std::runtime_error("Not an index manifest: " + path);
+        }
+        while (std::getline(in, line)) {
+            if (line.empty()) continue;
+            std::string kind = line.substr(0, line.find('\t'));
+            if (kind == "positions" || kind == "next") {
+                auto f = split_fields(line, 2);
+                if (f.size() != 2) throw std::runtime_error("Corrupt index manifest: " + path);
+                if (kind == "positions") positional = f[1] == "1";
+                else next_segment = std::stoull(f[1]);
+            } else if (kind == "segment") {
+                auto f = split_fields(line, 4);
+                if (f.size() != 4) throw std::runtime_error("Corrupt index manifest: " + path);
+                segment_list.push_back({f[1], std::stoull(f[2]), std::stoull(f[3])});
+            } else if (kind == "file") {
+                auto f = split_fields(line, 6);
+                if (f.size() != 6) throw std::runtime_error("Corrupt index manifest: " + path);
+                files[f[5]] = {f[1], std::stoull(f[2]), std::stoull(f[3]), std::stoll(f[4])};
+            } else if (kind == "deleted") {
+                auto f = split_fields(line, 4);
+                if (f.size() != 4) throw std::runtime_error("Corrupt index manifest: " + path);
+                tombstones.push_back({f[1], std::stoull(f[2]), f[3]});
+            } else {
+                throw std::runtime_error("Corrupt index manifest: " + path);
+            }
+        }
+    }
+
+public:
+    // Abre el manifiesto de directory o empieza uno vacio si todavia no existe
+    explicit IndexManifest(const std::string& index_directory) : directory(index_directory) {
+        std::string path = directory + "/" + FILE_NAME;
+        if (std::filesystem::exists(path)) load(path);
+    }
+
+    static bool is_index_directory(const std::string& path) {
+        return std::filesystem::is_regular_file(path + "/" + FILE_NAME);
+    }
+
+    bool get_positional() const {
+        return positional;
+    }
+
+    void set_positional(bool with_positions) {
+        positional = with_positions;
+    }
+
+    const std::vector<Segment>& segments() const {
+        return segment_list;
+    }
+
+    const std::map<std::string, File>& get_files() const {
+        return files;
+    }
+
+    std::string segment_path(const std::string& name) const {
+        return directory + "/" + name;
+    }
+
+    // Reserva el nombre de un segmento nuevo
+    std::string new_segment_name() {
+        char name[32];
+        std::snprintf(name, sizeof(name), "segment_%06llu.seg", static_cast<unsigned long long>(next_segment++));
+        return name;
+    }
+
+    const File* find_file(const std::string& path) const {
+        auto it = files.find(path);
+        return it == files.end() ? nullptr : &it->second;
+    }
+
+    void add_file(const std::string& path, const File& file) {
+        files[path] = file;
+    }
+
+    // Quita un archivo del indice; sus documentos quedan marcados como borrados
+    // en su segmento hasta que este se fusione
+    void remove_file(const std::string& path) {
+        auto it = files.find(path);
+        if (it == files.end()) return;
+        if (it->second.segment != NO_SEGMENT && it->second.docs > 0) {
+            tombstones.push_back({it->second.segment, it->second.docs, path});
+        }
+        files.erase(it);
+    }
+
+    void add_segment(const Segment& segment) {
+        segment_list.push_back(segment);
+    }
+
+    // Rutas borradas de un segmento
+    std::unordered_set<std::string> deleted_paths(const std::string& segment) const {
+        std::unordered_set<std::string> paths;
+        for (const auto& tombstone : tombstones) {
+            if (tombstone.segment == segment) paths.insert(tombstone.path);
+        }
+        return paths;
+    }
+
+    uint64_t deleted_docs(const std::string& segment) const {
+        uint64_t docs = 0;
+        for (const auto& tombstone : tombstones) {
+            if (tombstone.segment == segment) docs += tombstone.docs;
+        }
+        return docs;
+    }
+
+    // Sustituye los segmentos inputs por merged, que ya no tiene sus borrados. Si
+    // merged se quedo sin documentos simplemente desaparecen.
+    void replace_segments(const std::vector<std::string>& inputs, const Segment& merged) {
+        auto is_input = [&](const std::string& name) {
+            return std::find(inputs.begin(), inputs.end(), name) != inputs.end();
+        };
+        auto first = std::find_if(segment_list.begin(), segment_list.end(),
+                                  [&](const Segment& s) { return is_input(s.name); });
+        size_t position = static_cast<size_t>(first - segment_list.begin());
+        segment_list.erase(std::remove_if(segment_list.begin(), segment_list.end(),
+                                          [&](const Segment& s) { return is_input(s.name); }),
+                           segment_list.end());
+        if (merged.docs > 0) {
+            segment_list.insert(segment_list.begin() + std::min(position, segment_list.size()), merged);
+        }
+        tombstones.erase(std::remove_if(tombstones.begin(), tombstones.end(),
+                                        [&](const Tombstone& t) { return is_input(t.segment); }),
+                         tombstones.end());
+        for (auto& entry : files) {
+            if (is_input(entry.second.segment)) entry.second.segment = merged.name;
+        }
+    }
+
+    void save() const {
+        std::string path = directory + "/" + FILE_NAME;
+        std::string temp = path + ".tmp";
+        {
+            std::ofstream out(temp, std::ios::trunc);
+            out << "BDWMANIFEST\t1\n";
+            out << "positions\t" << (positional ? 1 : 0) << "\n";
+            out << "next\t" << next_segment << "\n";
+            for (const auto& segment : segment_list) {
+                out << "segment\t" << segment.name << "\t" << segment.docs << "\t" << segment.bytes << "\n";
+            }
+            for (const auto& [file_path, file] : files) {
+                out << "file\t" << file.segment << "\t" << file.docs << "\t" << file.size << "\t"
+                    << file.mtime << "\t" << file_path << "\n";
+            }
+            for (const auto& tombstone : tombstones) {
+                out << "deleted\t" << tombstone.segment << "\t" << tombstone.docs << "\t" << tombstone.path << "\n";
+            }
+            out.close();
+            if (!out) throw std::runtime_error("Failed to write index manifest: " + temp);
+        }
+        std::filesystem::rename(temp, path);
+    }
+};
+
+// Documentos borrados de un segmento del indice: los de sus archivos con tombstone
+inline std::vector<bool> deleted_documents(const IndexManifest& manifest, const std::string& segment,
+                                           const DocumentTable& documents) {
+    std::vector<bool> deleted(documents.size(), false);
+    std::unordered_set<std::string> paths = manifest.deleted_paths(segment);
+    if (paths.empty()) return deleted;
+    for (uint32_t doc = 0; doc < deleted.size(); ++doc) {
+        deleted[doc] = paths.count(documents.path(doc)) > 0;
+    }
+    return deleted;
+}
+
+// Politica de fusion por niveles: un segmento esta en el nivel
+// floor(log_factor(bytes / 1 MB)) y cuando un nivel junta merge_factor segmentos
+// se fusionan todos en uno, que queda en el nivel siguiente. Asi cada documento
+// se reescribe O(log n) veces. Un segmento con mas de la mitad de sus documentos
+// borrados se reescribe solo para recuperar el espacio.
+inline std::vector<std::vector<std::string>> plan_merges(const IndexManifest& manifest, size_t merge_factor) {
+    constexpr double BASE_BYTES = 1 << 20;
+    std::map<int, std::vector<std::string>> tiers;
+    for (const auto& segment : manifest.segments()) {
+        double ratio = std::max(1.0, static_cast<double>(segment.bytes) / BASE_BYTES);
+        int tier = static_cast<int>(std::log(ratio) / std::log(static_cast<double>(merge_factor)));
+        tiers[tier].push_back(segment.name);
+    }
+
+    std::vector<std::vector<std::string>> groups;
+    for (auto& [tier, names] : tiers) {
+        if (names.size() >= merge_factor) {
+            groups.push_back(names);
+            continue;
+        }
+        for (const auto& name : names) {
+            auto it = std::find_if(manifest.segments().begin(), manifest.segments().end(),
+                                   [&](const IndexManifest::Segment& s) { return s.name == name; });
+            if (2 * manifest.deleted_docs(name) > it->docs) groups.push_back({name});
+        }
+    }
+    return groups;
+}
+
+// Fusiona segmentos del indice en output quitando los documentos borrados. Los
+// documentos se renumeran en el orden de inputs, asi que la lista de cada
+// termino sale ya ordenada. Como en la fusion de runs, solo los postings del
+// termino en curso estan en memoria. Devuelve el numero de documentos.
+inline uint64_t merge_segments(const IndexManifest& manifest, const std::vector<std::string>& inputs,
+                               const std::string& output) {
+    constexpr uint32_t DELETED = UINT32_MAX;
+
+    std::vector<std::unique_ptr<SegmentReader>> readers;
+    std::vector<std::vector<uint32_t>> new_ids;  // Por segmento: id antiguo -> nuevo
+    DocumentTable merged_docs;
+    std::unordered_map<std::string, uint32_t> path_ids;
+    for (const auto& name : inputs) {
+        readers.push_back(std::make_unique<SegmentReader>(manifest.segment_path(name)));
+        DocumentTable docs;
+        readers.back()->load_documents(docs);
+        std::vector<bool> deleted = deleted_documents(manifest, name, docs);
+        std::vector<uint32_t> ids(docs.size(), DELETED);
+        for (uint32_t doc = 0; doc < docs.size(); ++doc) {
+            if (deleted[doc]) continue;
+            DocumentTable::Document info = docs.get(doc);
+            std::string path = docs.path(doc);
+            auto [it, inserted] = path_ids.try_emplace(path, 0);
+            if (inserted) it->second = merged_docs.add_path(path);
+            ids[doc] = merged_docs.add(it->second, info.chunk_id, info.offset);
+            merged_docs.set_length(ids[doc], info.length);
+        }
+        new_ids.push_back(std::move(ids));
+    }
+
+    bool positional = manifest.get_positional();
+    SegmentWriter writer(output, positional);
+    std::vector<SegmentReader::Iterator> cursors;
+    for (const auto& reader : readers) {
+        cursors.push_back(reader->terms());
+    }
+    // A igualdad de termino sale antes el segmento anterior, que tiene los ids menores
+    auto greater_term = [&](size_t a, size_t b) {
+        int cmp = cursors[a].entry().term.compare(cursors[b].entry().term);
+        return cmp > 0 || (cmp == 0 && a > b);
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(greater_term)> heap(greater_term);
+    for (size_t i = 0; i < cursors.size(); ++i) {
+        if (cursors[i].next()) heap.push(i);
+    }
+
+    std::string term;
+    PostingList merged;
+    PostingList docs;
+    std::string merged_positions;
+    while (!heap.empty()) {
+        term.assign(cursors[heap.top()].entry().term);
+        merged.clear();
+        merged_positions.clear();
+        while (!heap.empty() && cursors[heap.top()].entry().term == term) {
+            size_t run = heap.top();
+            heap.pop();
+            cursors[run].postings(docs);
+            std::string_view positions = positional ? cursors[run].positions() : std::string_view();
+            const char* p = positions.data();
+            for (const auto& posting : docs) {
+                uint32_t id = new_ids[run][posting.doc];
+                if (positional) {
+                    const char* start = p;
+                    p = skip_varints(p, positions.data() + positions.size(), posting.freq);
+                    if (id != DELETED) merged_positions.append(start, static_cast<size_t>(p - start));
+                }
+                if (id != DELETED) merged.push_back({id, posting.freq});
+            }
+            if (cursors[run].next()) heap.push(run);
+        }
+        // Un termino que solo estaba en documentos borrados desaparece
+        if (!merged.empty()) writer.add(term, merged, merged_positions);
+    }
+    writer.finish(&merged_docs);
+    return merged_docs.size();
+}
@@ -0,0 +1,840 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "../00_Common/mappedFile.hpp"
+
+// Aparicion de un termino en un documento: id del documento y numero de veces
+struct Posting {
+    uint32_t doc;
+    uint32_t freq;
+
+    bool operator<(const Posting& other) const {
+        return doc < other.doc;
+    }
+};
+
+// Lista de postings de un termino, ordenada por documento y sin repetidos al escribirla.
+using PostingList = std::vector<Posting>;
+
+// ---------------------------------------------------------------------------
+// Codificacion varint (7 bits por byte, el bit alto indica que sigue otro byte)
+// ---------------------------------------------------------------------------
+
+inline void put_varint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+inline uint64_t get_varint(const char*& p, const char* end) {
+    uint64_t value = 0;
+    int shift = 0;
+    while (p < end) {
+        uint8_t byte = static_cast<uint8_t>(*p++);
+        value |= uint64_t(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return value;
+        shift += 7;
+    }
+    throw std::runtime_error("Truncated varint in index segment");
+}
+
+inline void put_u64(std::string& out, uint64_t value) {
+    char bytes[8];
+    std::memcpy(bytes, &value, 8);
+    out.append(bytes, 8);
+}
+
+inline uint64_t get_u64(const char* p) {
+    uint64_t value;
+    std::memcpy(&value, p, 8);
+    return value;
+}
+
+// Cada SKIP_INTERVAL postings hay una entrada de salto que permite empezar a
+// decodificar en mitad de la lista sin leer los huecos anteriores
+constexpr size_t SKIP_INTERVAL = 128;
+constexpr size_t SKIP_ENTRY_SIZE = 8;
+
+// Entradas de salto de una lista de count postings: una por bloque salvo el primero
+inline uint64_t num_skips(uint64_t count) {
+    return count > 0 ? (count - 1) / SKIP_INTERVAL : 0;
+}
+
+// Postings como huecos (delta) entre ids consecutivos seguidos de la frecuencia,
+// ambos en varint. Delante va la tabla de saltos: para el bloque k (k >= 1), el
+// ultimo doc del bloque anterior (u32) y el byte donde empieza el bloque (u32).
+inline void encode_postings(std::string& out, const PostingList& docs) {
+    size_t table = out.size();
+    out.append(num_skips(docs.size()) * SKIP_ENTRY_SIZE, '\0');
+    size_t data = out.size();
+    uint32_t previous = 0;
+    for (size_t i = 0; i < docs.size(); ++i) {
+        if (i > 0 && i % SKIP_INTERVAL == 0) {
+            uint32_t entry[2] = {previous, static_cast<uint32_t>(out.size() - data)};
+            std::memcpy(&out[table + (i / SKIP_INTERVAL - 1) * SKIP_ENTRY_SIZE], entry, SKIP_ENTRY_SIZE);
+        }
+        put_varint(out, docs[i].doc - previous);
+        put_varint(out, docs[i].freq);
+        previous = docs[i].doc;
+    }
+}
+
+// Salta n varints sin decodificarlos
+inline const char* skip_varints(const char* p, const char* end, uint64_t n) {
+    while (n > 0) {
+        if (p >= end) throw std::runtime_error("Truncated varint in index segment");
+        if (!(static_cast<uint8_t>(*p++) & 0x80)) n--;
+    }
+    return p;
+}
+
+// Posiciones de un termino (solo en los indices con --positions): para cada
+// posting, en el mismo orden, sus freq posiciones dentro del documento como huecos
+// en varint (la primera desde 0). Se guardan aparte de los postings para que las
+// consultas que no las necesitan no las lean. Delante va una tabla de saltos con
+// el byte donde empiezan las posiciones de cada bloque de SKIP_INTERVAL postings
+// (u64, k >= 1), para seguir a PostingCursor cuando salta bloques.
+constexpr size_t POSITION_SKIP_ENTRY_SIZE = 8;
+
+inline void encode_positions(std::string& out, const PostingList& docs, std::string_view positions) {
+    size_t table = out.size();
+    out.append(num_skips(docs.size()) * POSITION_SKIP_ENTRY_SIZE, '\0');
+    const char* p = positions.data();
+    const char* end = p + positions.size();
+    for (size_t i = 0; i < docs.size(); ++i) {
+        if (i > 0 && i % SKIP_INTERVAL == 0) {
+            uint64_t offset = static_cast<uint64_t>(p - positions.data());
+            std::memcpy(&out[table + (i / SKIP_INTERVAL - 1) * POSITION_SKIP_ENTRY_SIZE], &offset, 8);
+        }
+        p = skip_varints(p, end, docs[i].freq);
+    }
+    if (p != end) {
+        throw std::logic_error("Positions do not match the posting frequencies");
+    }
+    out.append(positions.data(), positions.size());
+}
+
+// Ordena los postings por documento moviendo con cada uno sus posiciones
+inline void sort_postings(PostingList& docs, std::string& positions) {
+    if (std::is_sorted(docs.begin(), docs.end())) return;
+    std::vector<size_t> starts(docs.size() + 1, 0);
+    const char* p = positions.data();
+    for (size_t i = 0; i < docs.size(); ++i) {
+        p = skip_varints(p, positions.data() + positions.size(), docs[i].freq);
+        starts[i + 1] = static_cast<size_t>(p - positions.data());
+    }
+    std::vector<uint32_t> order(docs.size());
+    for (uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return docs[a] < docs[b]; });
+
+    PostingList sorted_docs;
+    std::string sorted_positions;
+    sorted_docs.reserve(docs.size());
+    sorted_positions.reserve(positions.size());
+    for (uint32_t i : order) {
+        sorted_docs.push_back(docs[i]);
+        sorted_positions.append(positions, starts[i], starts[i + 1] - starts[i]);
+    }
+    docs.swap(sorted_docs);
+    positions.swap(sorted_positions);
+}
+
+// version es la del segmento: la 1 no tiene tabla de saltos y hasta la 2 no hay
+// frecuencias (se leen como 1)
+inline void decode_postings(const char* p, const char* end, uint64_t count, PostingList& out,
+                            uint32_t version) {
+    if (version >= 2) p += num_skips(count) * SKIP_ENTRY_SIZE;
+    out.clear();
+    out.reserve(count);
+    uint32_t doc = 0;
+    for (uint64_t i = 0; i < count; ++i) {
+        doc += static_cast<uint32_t>(get_varint(p, end));
+        uint32_t freq = version >= 3 ? static_cast<uint32_t>(get_varint(p, end)) : 1;
+        out.push_back({doc, freq});
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Tabla de documentos: cada chunk de cada archivo es un documento con un id
+// uint32_t denso, asignado en el orden de lectura. El nombre en texto
+// ("archivo_chunk_N") solo se construye al escribir la salida.
+// ---------------------------------------------------------------------------
+
+class DocumentTable {
+public:
+    struct Document {
+        uint32_t path_index;  // Posicion en paths
+        uint32_t chunk_id;    // ID del chunk dentro del archivo
+        uint64_t offset;      // Byte donde empieza el chunk dentro del archivo
+        uint32_t length = 0;  // Numero de palabras, para normalizar el ranking
+    };
+
+private:
+    std::vector<std::string> paths;
+    std::vector<Document> documents;
+    mutable std::mutex mutex;
+    // Solo despues de restore (index --resume): rutas y chunks que ya estaban
+    // registrados. add_path y add devuelven sus ids anteriores, asi los runs del
+    // checkpoint siguen apuntando a los mismos documentos.
+    std::unordered_map<std::string, uint32_t> restored_paths;
+    std::unordered_map<uint64_t, uint32_t> restored_docs;  // path_index << 32 | chunk_id
+
+public:
+    uint32_t add_path(const std::string& path) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!restored_paths.empty()) {
+            auto it = restored_paths.find(path);
+            if (it != restored_paths.end()) return it->second;
+        }
+        paths.push_back(path);
+        return static_cast<uint32_t>(paths.size() - 1);
+    }
+
+    uint32_t add(uint32_t path_index, uint32_t chunk_id, uint64_t offset) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!restored_docs.empty()) {
+            auto it = restored_docs.find(static_cast<uint64_t>(path_index) << 32 | chunk_id);
+            if (it != restored_docs.end()) {
+                // Otro corte en chunks cambiaria el texto de los documentos del checkpoint
+                if (documents[it->second].offset != offset) {
+                    throw std::runtime_error("Chunk " + std::to_string(chunk_id) + " of " + paths[path_index] +
+                                             " does not match the checkpoint");
+                }
+                return it->second;
+            }
+        }
+        documents.push_back({path_index, chunk_id, offset});
+        return static_cast<uint32_t>(documents.size() - 1);
+    }
+
+    // Carga una tabla serializada por un checkpoint y recuerda sus rutas y chunks
+    void restore(const char* p, const char* end, uint32_t version) {
+        deserialize(p, end, version);
+        std::unique_lock<std::mutex> lock(mutex);
+        for (uint32_t i = 0; i < paths.size(); ++i) {
+            restored_paths.emplace(paths[i], i);
+        }
+        for (uint32_t doc = 0; doc < documents.size(); ++doc) {
+            restored_docs.emplace(static_cast<uint64_t>(documents[doc].path_index) << 32 | documents[doc].chunk_id, doc);
+        }
+    }
+
+    // Se llama cuando se termina de indexar el documento
+    void set_length(uint32_t doc_id, uint32_t length) {
+        std::unique_lock<std::mutex> lock(mutex);
+        documents[doc_id].length = length;
+    }
+
+    uint32_t length(uint32_t doc_id) const {
+        std::unique_lock<std::mutex> lock(mutex);
+        return documents[doc_id].length;
+    }
+
+    Document get(uint32_t doc_id) const {
+        std::unique_lock<std::mutex> lock(mutex);
+        return documents[doc_id];
+    }
+
+    std::string path(uint32_t doc_id) const {
+        std::unique_lock<std::mutex> lock(mutex);
+        return paths[documents[doc_id].path_index];
+    }
+
+    std::string name(uint32_t doc_id) const {
+        std::unique_lock<std::mutex> lock(mutex);
+        const Document& doc = documents[doc_id];
+        return std::filesystem::path(paths[doc.path_index]).filename().string() +
+               "_chunk_" + std::to_string(doc.chunk_id);
+    }
+
+    size_t size() const {
+        std::unique_lock<std::mutex> lock(mutex);
+        return documents.size();
+    }
+
+    size_t num_paths() const {
+        std::unique_lock<std::mutex> lock(mutex);
+        return paths.size();
+    }
+
+    std::string path_name(uint32_t path_index) const {
+        std::unique_lock<std::mutex> lock(mutex);
+        return paths[path_index];
+    }
+
+    void serialize(std::string& out) const {
+        std::unique_lock<std::mutex> lock(mutex);
+        put_varint(out, paths.size());
+        for (const auto& path : paths) {
+            put_varint(out, path.size());
+            out.append(path);
+        }
+        put_varint(out, documents.size());
+        for (const auto& doc : documents) {
+            put_varint(out, doc.path_index);
+            put_varint(out, doc.chunk_id);
+            put_varint(out, doc.offset);
+            put_varint(out, doc.length);
+        }
+    }
+
+    // Los segmentos anteriores a la version 3 no guardan la longitud de cada documento
+    void deserialize(const char* p, const char* end, uint32_t version) {
+        std::unique_lock<std::mutex> lock(mutex);
+        paths.clear();
+        documents.clear();
+        uint64_t num_paths = get_varint(p, end);
+        for (uint64_t i = 0; i < num_paths; ++i) {
+            uint64_t len = get_varint(p, end);
+            paths.emplace_back(p, len);
+            p += len;
+        }
+        uint64_t num_docs = get_varint(p, end);
+        documents.reserve(num_docs);
+        for (uint64_t i = 0; i < num_docs; ++i) {
+            Document doc;
+            doc.path_index = static_cast<uint32_t>(get_varint(p, end));
+            doc.chunk_id = static_cast<uint32_t>(get_varint(p, end));
+            doc.offset = get_varint(p, end);
+            if (version >= 3) doc.length = static_cast<uint32_t>(get_varint(p, end));
+            documents.push_back(doc);
+        }
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Segmento binario del indice invertido (version 4). Se usa tanto para los
+// archivos temporales como para la salida final.
+//
+//   Cabecera (segment_header_size bytes)
+//     magic "BDWIDX\0\0", version u32, flags u32, num_terms u64, num_docs u64,
+//     y (offset, bytes) u64 de cada seccion: postings, diccionario, bloques,
+//     documentos y posiciones
+//   Postings      un tramo por termino en orden de termino: tabla de saltos y
+//                 pares (hueco delta, frecuencia) en varint (ver encode_postings)
+//   Posiciones    solo con el flag SEGMENT_POSITIONS: un tramo por termino en el
+//                 mismo orden (ver encode_positions); si no, la seccion esta vacia
+//   Diccionario   por termino: varint len, bytes, varint doc_count, varint postings_bytes,
+//                 varint max_freq (frecuencia maxima, cota para el ranking),
+//                 y con posiciones varint positions_bytes
+//   Bloques       cada TERMS_PER_BLOCK terminos: offset en el diccionario (u64),
+//                 offset en postings (u64) y offset en posiciones (u64) del
+//                 primer termino del bloque
+//   Documentos    DocumentTable serializada con la longitud de cada documento
+//                 (vacia en los archivos temporales)
+//
+// Las versiones 1 (sin tabla de saltos), 2 (sin frecuencias ni longitudes) y 3
+// (sin posiciones) se siguen pudiendo leer; hasta la 2 las frecuencias se leen como 1.
+//
+// Los terminos estan ordenados por bytes, por lo que se puede buscar un termino
+// con busqueda binaria sobre los bloques y recorrer el segmento en orden.
+// Todos los enteros fijos se escriben en little-endian (orden nativo en x86).
+// ---------------------------------------------------------------------------
+
+constexpr char SEGMENT_MAGIC[8] = {'B', 'D', 'W', 'I', 'D', 'X', 0, 0};
+constexpr uint32_t SEGMENT_VERSION = 4;
+constexpr size_t TERMS_PER_BLOCK = 64;
+// flags: el segmento guarda las posiciones de cada termino
+constexpr uint32_t SEGMENT_POSITIONS = 1;
+
+// Hasta la version 3 ni la cabecera ni los bloques tienen offsets de posiciones
+inline size_t segment_header_size(uint32_t version) {
+    return 8 + 4 + 4 + 8 + 8 + (version >= 4 ? 5 : 4) * 16;
+}
+
+inline size_t block_entry_size(uint32_t version) {
+    return version >= 4 ? 24 : 16;
+}
+
+struct SegmentHeader {
+    uint32_t version = SEGMENT_VERSION;
+    uint32_t flags = 0;
+    uint64_t num_terms = 0;
+    uint64_t num_docs = 0;
+    uint64_t postings_offset = 0, postings_bytes = 0;
+    uint64_t dict_offset = 0, dict_bytes = 0;
+    uint64_t blocks_offset = 0, blocks_bytes = 0;
+    uint64_t docs_offset = 0, docs_bytes = 0;
+    uint64_t positions_offset = 0, positions_bytes = 0;
+};
+
+// Escribe un segmento en streaming: los postings van directamente al archivo y
+// solo el diccionario y la tabla de bloques se acumulan en memoria. Las posiciones
+// se escriben a la vez en un archivo auxiliar que se copia detras de los postings
+// al terminar.
+class SegmentWriter {
+private:
+    std::string path;
+    std::ofstream out;
+    SegmentHeader header;
+    std::string buffer;      // postings pendientes de escribir
+    std::string dictionary;
+    std::string blocks;
+    std::string last_term;
+    std::string positions_path;
+    std::ofstream positions_out;
+    std::string positions_buffer;  // posiciones pendientes de escribir
+
+    void flush_buffer() {
+        out.write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+
+    void flush_positions() {
+        positions_out.write(positions_buffer.data(), positions_buffer.size());
+        positions_buffer.clear();
+    }
+
+public:
+    SegmentWriter(const std::string& file_path, bool with_positions = false)
+        : path(file_path), out(file_path, std::ios::binary) {
+        if (!out.is_open()) {
+            throw std::runtime_error("Failed to open segment for writing: " + file_path);
+        }
+        std::string placeholder(segment_header_size(SEGMENT_VERSION), '\0');
+        out.write(placeholder.data(), placeholder.size());
+        header.postings_offset = placeholder.size();
+        if (with_positions) {
+            header.flags |= SEGMENT_POSITIONS;
+            positions_path = file_path + ".positions";
+            positions_out.open(positions_path, std::ios::binary);
+            if (!positions_out.is_open()) {
+                throw std::runtime_error("Failed to open segment for writing: " + positions_path);
+            }
+        }
+    }
+
+    ~SegmentWriter() {
+        if (!positions_path.empty()) {
+            std::error_code error;
+            std::filesystem::remove(positions_path, error);
+        }
+    }
+
+    // Los terminos deben llegar en orden creciente y docs debe estar ordenada.
+    // Si el segmento guarda posiciones, positions son las de docs en ese orden.
+    void add(std::string_view term, const PostingList& docs, std::string_view positions = {}) {
+        if (header.num_terms > 0 && term <= std::string_view(last_term)) {
+            throw std::logic_error("Segment terms must be added in sorted order");
+        }
+        if (header.num_terms % TERMS_PER_BLOCK == 0) {
+            put_u64(blocks, dictionary.size());
+            put_u64(blocks, header.postings_bytes);
+            put_u64(blocks, header.positions_bytes);
+        }
+
+        size_t before = buffer.size();
+        encode_postings(buffer, docs);
+        size_t postings_bytes = buffer.size() - before;
+        header.postings_bytes += postings_bytes;
+
+        put_varint(dictionary, term.size());
+        dictionary.append(term.data(), term.size());
+        put_varint(dictionary, docs.size());
+        put_varint(dictionary, postings_bytes);
+        uint32_t max_freq = 0;
+        for (const auto& posting : docs) {
+            max_freq = std::max(max_freq, posting.freq);
+        }
+        put_varint(dictionary, max_freq);
+
+        if (header.flags & SEGMENT_POSITIONS) {
+            before = positions_buffer.size();
+            encode_positions(positions_buffer, docs, positions);
+            size_t positions_bytes = positions_buffer.size() - before;
+            header.positions_bytes += positions_bytes;
+            put_varint(dictionary, positions_bytes);
+            if (positions_buffer.size() >= (1 << 20)) flush_positions();
+        }
+
+        last_term.assign(term.data(), term.size());
+        header.num_terms++;
+        if (buffer.size() >= (1 << 20)) flush_buffer();
+    }
+
+    // Escribe diccionario, bloques, documentos (si se pasan) y la cabecera definitiva
+    void finish(const DocumentTable* documents = nullptr) {
+        flush_buffer();
+
+        header.positions_offset = header.postings_offset + header.postings_bytes;
+        if (header.flags & SEGMENT_POSITIONS) {
+            flush_positions();
+            positions_out.close();
+            if (!positions_out) {
+                throw std::runtime_error("Failed to write segment: " + positions_path);
+            }
+            if (header.positions_bytes > 0) {
+                std::ifstream in(positions_path, std::ios::binary);
+                out << in.rdbuf();
+            }
+        }
+
+        header.dict_offset = header.positions_offset + header.positions_bytes;
+        header.dict_bytes = dictionary.size();
+        out.write(dictionary.data(), dictionary.size());
+
+        header.blocks_offset = header.dict_offset + header.dict_bytes;
+        header.blocks_bytes = blocks.size();
+        out.write(blocks.data(), blocks.size());
+
+        std::string docs;
+        if (documents) {
+            documents->serialize(docs);
+            header.num_docs = documents->size();
+        }
+        header.docs_offset = header.blocks_offset + header.blocks_bytes;
+        header.docs_bytes = docs.size();
+        out.write(docs.data(), docs.size());
+
+        std::string head(SEGMENT_MAGIC, 8);
+        head.append(reinterpret_cast<const char*>(&header.version), 4);
+        head.append(reinterpret_cast<const char*>(&header.flags), 4);
+        for (uint64_t value : {header.num_terms, header.num_docs,
+                               header.postings_offset, header.postings_bytes,
+                               header.dict_offset, header.dict_bytes,
+                               header.blocks_offset, header.blocks_bytes,
+                               header.docs_offset, header.docs_bytes,
+                               header.positions_offset, header.positions_bytes}) {
+            put_u64(head, value);
+        }
+        out.seekp(0);
+        out.write(head.data(), head.size());
+        out.close();
+        if (!out) {
+            throw std::runtime_error("Failed to write segment: " + path);
+        }
+    }
+};
+
+// Entrada del diccionario de un segmento
+struct TermEntry {
+    std::string_view term;
+    uint64_t doc_count = 0;
+    uint64_t postings_offset = 0;  // Relativo a la seccion de postings
+    uint64_t postings_bytes = 0;
+    uint32_t max_freq = 1;
+    uint64_t positions_offset = 0;  // Relativo a la seccion de posiciones
+    uint64_t positions_bytes = 0;
+};
+
+// Recorre los postings de un termino sin decodificarlos todos: next() avanza un
+// documento y advance(target) salta bloques completos con la tabla de saltos
+// (busqueda exponencial y luego binaria sobre el ultimo doc de cada bloque) antes
+// de decodificar solo el bloque donde puede estar target. Si se le asocian las
+// posiciones del termino, positions() decodifica las del documento actual; las de
+// los documentos por los que se pasa sin pedirlas solo se saltan.
+class PostingCursor {
+private:
+    const char* skips = nullptr;
+    const char* data = nullptr;
+    const char* p = nullptr;
+    const char* end = nullptr;
+    uint64_t count = 0;
+    uint64_t skip_count = 0;
+    uint64_t index = 0;    // Posicion del documento actual
+    uint32_t current = 0;
+    uint32_t current_freq = 0;
+    bool with_freqs = false;
+    const char* position_skips = nullptr;
+    const char* position_data = nullptr;  // nullptr si no se usan posiciones
+    const char* position_p = nullptr;
+    const char* position_end = nullptr;
+    uint64_t pending_positions = 0;  // Posiciones a saltar desde position_p hasta las del doc actual
+
+    uint32_t skip_doc(uint64_t block) const {
+        uint32_t doc;
+        std::memcpy(&doc, skips + (block - 1) * SKIP_ENTRY_SIZE, 4);
+        return doc;
+    }
+
+    uint32_t skip_offset(uint64_t block) const {
+        uint32_t offset;
+        std::memcpy(&offset, skips + (block - 1) * SKIP_ENTRY_SIZE + 4, 4);
+        return offset;
+    }
+
+    void decode_next(uint32_t previous) {
+        current = previous + static_cast<uint32_t>(get_varint(p, end));
+        current_freq = with_freqs ? static_cast<uint32_t>(get_varint(p, end)) : 1;
+    }
+
+public:
+    static constexpr uint32_t END = UINT32_MAX;
+
+    PostingCursor() : current(END) {}
+
+    PostingCursor(const char* start, const char* stop, uint64_t doc_count, uint32_t version)
+        : end(stop), count(doc_count), skip_count(version >= 2 ? num_skips(doc_count) : 0),
+          with_freqs(version >= 3) {
+        skips = start;
+        data = start + skip_count * SKIP_ENTRY_SIZE;
+        p = data;
+        if (count == 0) {
+            current = END;
+        } else {
+            decode_next(0);
+        }
+    }
+
+    // Documento actual o END si se termino la lista
+    uint32_t doc() const {
+        return current;
+    }
+
+    // Frecuencia del termino en el documento actual
+    uint32_t freq() const {
+        return current_freq;
+    }
+
+    uint64_t size() const {
+        return count;
+    }
+
+    // Asocia las posiciones del termino (ver encode_positions); antes de moverse
+    void attach_positions(const char* start, const char* stop) {
+        position_skips = start;
+        position_data = start + skip_count * POSITION_SKIP_ENTRY_SIZE;
+        position_p = position_data;
+        position_end = stop;
+        pending_positions = 0;
+    }
+
+    // Posiciones del termino en el documento actual, en orden creciente
+    void positions(std::vector<uint32_t>& out) {
+        position_p = skip_varints(position_p, position_end, pending_positions);
+        pending_positions = 0;
+        out.clear();
+        const char* p = position_p;
+        uint32_t position = 0;
+        for (uint32_t i = 0; i < current_freq; ++i) {
+            position += static_cast<uint32_t>(get_varint(p, position_end));
+            out.push_back(position);
+        }
+    }
+
+    void next() {
+        if (current == END) return;
+        if (position_data) pending_positions += current_freq;
+        if (++index >= count) {
+            current = END;
+            return;
+        }
+        decode_next(current);
+    }
+
+    // Primer documento >= target
+    void advance(uint32_t target) {
+        if (current >= target) return;
+        uint64_t block = index / SKIP_INTERVAL;
+        if (block < skip_count && skip_doc(block + 1) < target) {
+            // El ultimo bloque cuyo doc anterior es < target
+            uint64_t lo = block + 1;
+            uint64_t step = 1;
+            uint64_t hi = lo + step;
+            while (hi <= skip_count && skip_doc(hi) < target) {
+                lo = hi;
+                step *= 2;
+                hi = lo + step;
+            }
+            hi = std::min<uint64_t>(hi, skip_count + 1);
+            while (hi - lo > 1) {
+                uint64_t mid = (lo + hi) / 2;
+                if (skip_doc(mid) < target) lo = mid; else hi = mid;
+            }
+            p = data + skip_offset(lo);
+            index = lo * SKIP_INTERVAL;
+            decode_next(skip_doc(lo));
+            if (position_data) {
+                position_p = position_data + get_u64(position_skips + (lo - 1) * POSITION_SKIP_ENTRY_SIZE);
+                pending_positions = 0;
+            }
+        }
+        while (current < target) next();
+    }
+};
+
+// Lee un segmento mapeado en memoria. Permite recorrer los terminos en orden
+// (para fusionar) o buscar uno concreto (para consultas).
+class SegmentReader {
+private:
+    MappedFile file;
+    SegmentHeader header;
+    const char* base = nullptr;
+
+    const char* section(uint64_t offset) const {
+        return base + offset;
+    }
+
+public:
+    explicit SegmentReader(const std::string& path) : file(path) {
+        std::string_view data = file.view();
+        if (data.size() < segment_header_size(1) || std::memcmp(data.data(), SEGMENT_MAGIC, 8) != 0) {
+            throw std::runtime_error("Not an index segment: " + path);
+        }
+        base = data.data();
+        std::memcpy(&header.version, base + 8, 4);
+        std::memcpy(&header.flags, base + 12, 4);
+        if (header.version < 1 || header.version > SEGMENT_VERSION) {
+            throw std::runtime_error("Unsupported segment version " + std::to_string(header.version) + ": " + path);
+        }
+        if (data.size() < segment_header_size(header.version)) {
+            throw std::runtime_error("Truncated index segment: " + path);
+        }
+        uint64_t* fields[] = {&header.num_terms, &header.num_docs,
+                              &header.postings_offset, &header.postings_bytes,
+                              &header.dict_offset, &header.dict_bytes,
+                              &header.blocks_offset, &header.blocks_bytes,
+                              &header.docs_offset, &header.docs_bytes,
+                              &header.positions_offset, &header.positions_bytes};
+        size_t num_fields = header.version >= 4 ? 12 : 10;
+        for (size_t i = 0; i < num_fields; ++i) {
+            *fields[i] = get_u64(base + 16 + i * 8);
+        }
+        if (header.docs_offset + header.docs_bytes > data.size() ||
+            header.positions_offset + header.positions_bytes > data.size()) {
+            throw std::runtime_error("Truncated index segment: " + path);
+        }
+    }
+
+    const SegmentHeader& get_header() const {
+        return header;
+    }
+
+    size_t num_terms() const {
+        return header.num_terms;
+    }
+
+    bool has_positions() const {
+        return (header.flags & SEGMENT_POSITIONS) != 0;
+    }
+
+    // Recorrido secuencial del diccionario en orden de termino
+    class Iterator {
+    private:
+        const SegmentReader* reader;
+        const char* p;
+        const char* end;
+        uint64_t postings_offset = 0;
+        uint64_t positions_offset = 0;
+        TermEntry current;
+
+    public:
+        Iterator(const SegmentReader* r, const char* start, const char* stop, uint64_t first_postings,
+                 uint64_t first_positions)
+            : reader(r), p(start), end(stop), postings_offset(first_postings), positions_offset(first_positions) {}
+
+        bool next() {
+            if (p >= end) return false;
+            uint64_t len = get_varint(p, end);
+            current.term = std::string_view(p, len);
+            p += len;
+            current.doc_count = get_varint(p, end);
+            current.postings_bytes = get_varint(p, end);
+            current.max_freq = reader->header.version >= 3 ? static_cast<uint32_t>(get_varint(p, end)) : 1;
+            current.positions_bytes = reader->has_positions() ? get_varint(p, end) : 0;
+            current.postings_offset = postings_offset;
+            postings_offset += current.postings_bytes;
+            current.positions_offset = positions_offset;
+            positions_offset += current.positions_bytes;
+            return true;
+        }
+
+        const TermEntry& entry() const {
+            return current;
+        }
+
+        void postings(PostingList& out) const {
+            reader->read_postings(current, out);
+        }
+
+        std::string_view positions() const {
+            return reader->positions(current);
+        }
+    };
+
+    Iterator terms() const {
+        const char* dict = section(header.dict_offset);
+        return Iterator(this, dict, dict + header.dict_bytes, 0, 0);
+    }
+
+    void read_postings(const TermEntry& entry, PostingList& out) const {
+        const char* p = section(header.postings_offset + entry.postings_offset);
+        decode_postings(p, p + entry.postings_bytes, entry.doc_count, out, header.version);
+    }
+
+    // Posiciones de todos los postings del termino, sin la tabla de saltos
+    // (vacio si el segmento no guarda posiciones)
+    std::string_view positions(const TermEntry& entry) const {
+        if (entry.positions_bytes == 0) return {};
+        const char* p = section(header.positions_offset + entry.positions_offset);
+        size_t table = num_skips(entry.doc_count) * POSITION_SKIP_ENTRY_SIZE;
+        return std::string_view(p + table, entry.positions_bytes - table);
+    }
+
+    // Cursor sobre los postings de un termino que decodifica bajo demanda; con
+    // with_positions (solo si has_positions()) tambien puede dar sus posiciones
+    PostingCursor cursor(const TermEntry& entry, bool with_positions = false) const {
+        const char* p = section(header.postings_offset + entry.postings_offset);
+        PostingCursor result(p, p + entry.postings_bytes, entry.doc_count, header.version);
+        if (with_positions) {
+            const char* q = section(header.positions_offset + entry.positions_offset);
+            result.attach_positions(q, q + entry.positions_bytes);
+        }
+        return result;
+    }
+
+    // Busqueda binaria sobre el primer termino de cada bloque y luego lineal
+    bool find(std::string_view term, TermEntry& entry) const {
+        size_t entry_size = block_entry_size(header.version);
+        size_t num_blocks = header.blocks_bytes / entry_size;
+        if (num_blocks == 0) return false;
+        const char* blocks = section(header.blocks_offset);
+        const char* dict = section(header.dict_offset);
+        const char* dict_end = dict + header.dict_bytes;
+
+        auto first_term = [&](size_t block) {
+            const char* p = dict + get_u64(blocks + block * entry_size);
+            uint64_t len = get_varint(p, dict_end);
+            return std::string_view(p, len);
+        };
+
+        size_t lo = 0, hi = num_blocks;
+        while (hi - lo > 1) {
+            size_t mid = (lo + hi) / 2;
+            if (first_term(mid) <= term) lo = mid; else hi = mid;
+        }
+
+        const char* block = blocks + lo * entry_size;
+        const char* start = dict + get_u64(block);
+        const char* stop = (lo + 1 < num_blocks) ? dict + get_u64(block + entry_size) : dict_end;
+        Iterator it(this, start, stop, get_u64(block + 8), header.version >= 4 ? get_u64(block + 16) : 0);
+        while (it.next()) {
+            if (it.entry().term == term) {
+                entry = it.entry();
+                return true;
+            }
+            if (it.entry().term > term) break;
+        }
+        return false;
+    }
+
+    void load_documents(DocumentTable& documents) const {
+        const char* p = section(header.docs_offset);
+        if (header.docs_bytes > 0) {
+            documents.deserialize(p, p + header.docs_bytes, header.version);
+        }
+    }
+};
@@ -0,0 +1,112 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <iomanip>
+#include <exception>
+
+#include "../00_Common/commandLine.hpp"
+#include "../00_Common/tokenizer.hpp"
+#include "queryEngine.hpp"
+
+using namespace std;
+
+// Consultas booleanas o de ranking BM25 (--rank) sobre el segmento binario que
+// escribe index o sobre el directorio de un indice incremental. Sin --query lee
+// una consulta por linea de la entrada estandar.
+int main(int argc, char* argv[]) {
+    CommandLine args(argc, argv);
+    if (args.positional.size() < 1) {
+        cerr << "Usage: " << argv[0] << " <index_file|index_directory> [--query=QUERY] [--limit=N] [--normalize=MODE] [--rank] [--k1=X] [--b=X]" << endl;
+        return 1;
+    }
+
+    string index_file = args.positional[0];
+    // Documentos que se muestran por consulta (el total siempre se cuenta entero);
+    // con --rank es el k del top-k
+    size_t limit = stoul(args.get("limit", "10"));
+    bool ranked = args.has("rank");
+    // Debe ser el mismo modo con el que se construyo el indice
+    unsigned normalize = parse_normalize_mode(args.get("normalize"));
+
+    auto load_start = chrono::steady_clock::now();
+    unique_ptr<QueryEngine> engine;
+    try {
+        engine = make_unique<QueryEngine>(index_file, normalize);
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    double load_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - load_start).count();
+    engine->set_bm25(stod(args.get("k1", "1.2")), stod(args.get("b", "0.75")));
+
+    cout << "Index: " << index_file << " (";
+    if (engine->num_segments() != 1) cout << engine->num_segments() << " segments, ";
+    cout << engine->num_terms() << " terms, " << engine->num_documents() << " documents) loaded in "
+         << fixed << setprecision(3) << load_ms << " ms" << endl;
+
+    vector<double> latencies;
+    auto run = [&](const string& query) {
+        try {
+            if (ranked) {
+                auto start = chrono::steady_clock::now();
+                RankedResults results = engine->rank(query, limit);
+                double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+                latencies.push_back(ms);
+
+                cout << "\nQuery: " << query << endl;
+                cout << "Top " << results.docs.size() << " (" << fixed << setprecision(3) << ms << " ms, "
+                     << results.scored << " documents scored)" << endl;
+                for (const auto& result : results.docs) {
+                    cout << "  " << setprecision(4) << result.score << "  "
+                         << engine->name(result.doc) << endl;
+                }
+                return;
+            }
+
+            auto start = chrono::steady_clock::now();
+            vector<uint32_t> docs = engine->evaluate(query);
+            double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            latencies.push_back(ms);
+
+            cout << "\nQuery: " << query << endl;
+            cout << "Results: " << docs.size() << " (" << fixed << setprecision(3) << ms << " ms)" << endl;
+            for (size_t i = 0; i < docs.size() && i < limit; ++i) {
+                cout << "  " << engine->name(docs[i]) << endl;
+            }
+            if (docs.size() > limit) {
+                cout << "  ... " << docs.size() - limit << " more" << endl;
+            }
+        } catch (const exception& e) {
+            cerr << "\nQuery: " << query << "\nError: " << e.what() << endl;
+        }
+    };
+
+    if (args.has("query")) {
+        run(args.get("query"));
+    } else {
+        string line;
+        while (getline(cin, line)) {
+            if (line.find_first_not_of(" \t\r") == string::npos) continue;
+            run(line);
+        }
+    }
+
+    if (latencies.size() > 1) {
+        vector<double> sorted = latencies;
+        sort(sorted.begin(), sorted.end());
+        double total = 0;
+        for (double ms : sorted) total += ms;
+        auto percentile = [&](double p) {
+            return sorted[min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()))];
+        };
+        cout << "\nQueries: " << sorted.size() << " - "
+             << "avg " << fixed << setprecision(3) << total / sorted.size() << " ms - "
+             << "p50 " << percentile(0.50) << " ms - "
+             << "p99 " << percentile(0.99) << " ms - "
+             << "max " << sorted.back() << " ms" << endl;
+    }
+
+    return 0;
+}
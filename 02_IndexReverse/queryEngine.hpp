@@ -0,0 +1,860 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../00_Common/tokenizer.hpp"
+#include "indexManifest.hpp"
+#include "indexSegment.hpp"
+
+// ---------------------------------------------------------------------------
+// Consultas booleanas sobre un segmento del indice.
+//
+//   casa perro          AND implicito (tambien "casa AND perro")
+//   casa OR perro
+//   casa NOT perro      tambien "casa -perro"
+//   (casa OR piso) AND NOT alquiler
+//   "de la casa"        frase: palabras seguidas y en ese orden
+//   "casa grande"~3     proximidad: en ese orden con hasta 3 palabras de mas entre ellas
+//
+// La consulta se convierte en un arbol de iteradores de documentos que avanzan
+// en orden creciente de id. Ninguna lista se decodifica entera: la interseccion
+// salta con advance() sobre las tablas de saltos del segmento, empezando por el
+// termino con menos documentos. Las frases y la proximidad necesitan un indice
+// con posiciones y solo decodifican las posiciones de los documentos que ya
+// contienen todas sus palabras.
+//
+// En modo ranking (rank) las palabras de la consulta que no estan bajo un NOT se
+// puntuan con BM25 y se devuelven los k mejores documentos. WAND evita puntuar
+// los documentos que no pueden entrar: cada termino tiene una cota de su
+// puntuacion (frecuencia maxima y documento mas corto) y solo se evalua un
+// documento si la suma de las cotas de los terminos que pueden contenerlo supera
+// la peor puntuacion del top-k actual.
+// ---------------------------------------------------------------------------
+
+// Iterador de documentos en orden creciente; doc() es END al terminar
+class DocIterator {
+public:
+    static constexpr uint32_t END = PostingCursor::END;
+
+    virtual ~DocIterator() = default;
+    virtual uint32_t doc() const = 0;
+    virtual void next() = 0;
+    // Primer documento >= target
+    virtual void advance(uint32_t target) = 0;
+    // Numero estimado de documentos, para ordenar las intersecciones
+    virtual uint64_t cost() const = 0;
+};
+
+class TermIterator : public DocIterator {
+private:
+    PostingCursor cursor;
+
+public:
+    explicit TermIterator(PostingCursor postings) : cursor(postings) {}
+
+    uint32_t doc() const override {
+        return cursor.doc();
+    }
+
+    void next() override {
+        cursor.next();
+    }
+
+    void advance(uint32_t target) override {
+        cursor.advance(target);
+    }
+
+    uint64_t cost() const override {
+        return cursor.size();
+    }
+};
+
+// Todos los documentos del segmento (base de un NOT sin terminos positivos)
+class AllDocsIterator : public DocIterator {
+private:
+    uint32_t current = 0;
+    uint32_t num_docs;
+
+public:
+    explicit AllDocsIterator(uint32_t docs) : current(docs > 0 ? 0 : END), num_docs(docs) {}
+
+    uint32_t doc() const override {
+        return current;
+    }
+
+    void next() override {
+        if (current != END && ++current >= num_docs) current = END;
+    }
+
+    void advance(uint32_t target) override {
+        if (current != END && target > current) current = target < num_docs ? target : END;
+    }
+
+    uint64_t cost() const override {
+        return num_docs;
+    }
+};
+
+// Interseccion de include menos la union de exclude. Se hace "leapfrog": el
+// iterador mas raro propone un candidato y los demas saltan hasta el; si alguno
+// lo supera, ese documento pasa a ser el nuevo candidato.
+class AndIterator : public DocIterator {
+private:
+    std::vector<std::unique_ptr<DocIterator>> include;
+    std::vector<std::unique_ptr<DocIterator>> exclude;
+    uint32_t current = END;
+
+    void find() {
+        uint32_t candidate = include[0]->doc();
+        size_t i = 1;
+        while (candidate != END) {
+            if (i < include.size()) {
+                include[i]->advance(candidate);
+                uint32_t found = include[i]->doc();
+                if (found == candidate) {
+                    i++;
+                    continue;
+                }
+                include[0]->advance(found);
+                candidate = include[0]->doc();
+                i = 1;
+                continue;
+            }
+
+            bool excluded = false;
+            for (auto& other : exclude) {
+                other->advance(candidate);
+                if (other->doc() == candidate) {
+                    excluded = true;
+                    break;
+                }
+            }
+            if (!excluded) break;
+            include[0]->next();
+            candidate = include[0]->doc();
+            i = 1;
+        }
+        current = candidate;
+    }
+
+public:
+    AndIterator(std::vector<std::unique_ptr<DocIterator>> positive, std::vector<std::unique_ptr<DocIterator>> negative)
+        : include(std::move(positive)), exclude(std::move(negative)) {
+        std::sort(include.begin(), include.end(), [](const auto& a, const auto& b) { return a->cost() < b->cost(); });
+        find();
+    }
+
+    uint32_t doc() const override {
+        return current;
+    }
+
+    void next() override {
+        if (current == END) return;
+        include[0]->next();
+        find();
+    }
+
+    void advance(uint32_t target) override {
+        if (current >= target) return;
+        include[0]->advance(target);
+        find();
+    }
+
+    uint64_t cost() const override {
+        return include[0]->cost();
+    }
+};
+
+// Frase o proximidad: las palabras aparecen en el orden de la frase y entre la
+// primera y la ultima sobran como mucho slop palabras (0 para una frase exacta).
+// Los documentos se intersecan como en AndIterator y solo en los candidatos se
+// comprueban las posiciones.
+class PhraseIterator : public DocIterator {
+private:
+    std::vector<PostingCursor> words;  // En el orden de la frase, con posiciones
+    std::vector<size_t> by_cost;       // Indices de words de menos a mas documentos
+    uint32_t slop;
+    uint32_t current = END;
+    std::vector<std::vector<uint32_t>> positions;
+    std::vector<size_t> next_match;
+
+    // Para cada posicion de la primera palabra se toma la primera aparicion de
+    // cada palabra siguiente detras de la anterior, que es la que deja la ventana
+    // mas corta. Al avanzar la primera posicion esas apariciones solo pueden
+    // avanzar, asi que cada lista se recorre una sola vez.
+    bool matches() {
+        for (size_t i = 0; i < words.size(); ++i) {
+            words[i].positions(positions[i]);
+            next_match[i] = 0;
+        }
+        uint64_t window = words.size() - 1 + uint64_t(slop);
+        for (uint32_t first : positions[0]) {
+            uint32_t last = first;
+            for (size_t i = 1; i < words.size() && last - first <= window; ++i) {
+                const auto& list = positions[i];
+                while (next_match[i] < list.size() && list[next_match[i]] <= last) next_match[i]++;
+                if (next_match[i] == list.size()) return false;
+                last = list[next_match[i]];
+            }
+            if (last - first <= window) return true;
+        }
+        return false;
+    }
+
+    void find() {
+        PostingCursor& lead = words[by_cost[0]];
+        while (true) {
+            uint32_t candidate = lead.doc();
+            size_t i = 1;
+            while (candidate != END && i < by_cost.size()) {
+                PostingCursor& other = words[by_cost[i]];
+                other.advance(candidate);
+                if (other.doc() == candidate) {
+                    i++;
+                    continue;
+                }
+                lead.advance(other.doc());
+                candidate = lead.doc();
+                i = 1;
+            }
+            if (candidate == END || matches()) {
+                current = candidate;
+                return;
+            }
+            lead.next();
+        }
+    }
+
+public:
+    PhraseIterator(std::vector<PostingCursor> phrase, uint32_t max_slop)
+        : words(std::move(phrase)), by_cost(words.size()), slop(max_slop),
+          positions(words.size()), next_match(words.size()) {
+        for (size_t i = 0; i < by_cost.size(); ++i) by_cost[i] = i;
+        std::sort(by_cost.begin(), by_cost.end(), [&](size_t a, size_t b) {
+            return words[a].size() < words[b].size();
+        });
+        find();
+    }
+
+    uint32_t doc() const override {
+        return current;
+    }
+
+    void next() override {
+        if (current == END) return;
+        words[by_cost[0]].next();
+        find();
+    }
+
+    void advance(uint32_t target) override {
+        if (current >= target) return;
+        words[by_cost[0]].advance(target);
+        find();
+    }
+
+    uint64_t cost() const override {
+        return words[by_cost[0]].size();
+    }
+};
+
+class OrIterator : public DocIterator {
+private:
+    std::vector<std::unique_ptr<DocIterator>> children;
+    uint32_t current = END;
+
+    void update() {
+        current = END;
+        for (const auto& child : children) {
+            current = std::min(current, child->doc());
+        }
+    }
+
+public:
+    explicit OrIterator(std::vector<std::unique_ptr<DocIterator>> options) : children(std::move(options)) {
+        update();
+    }
+
+    uint32_t doc() const override {
+        return current;
+    }
+
+    void next() override {
+        if (current == END) return;
+        for (auto& child : children) {
+            if (child->doc() == current) child->next();
+        }
+        update();
+    }
+
+    void advance(uint32_t target) override {
+        if (current >= target) return;
+        for (auto& child : children) {
+            child->advance(target);
+        }
+        update();
+    }
+
+    uint64_t cost() const override {
+        uint64_t total = 0;
+        for (const auto& child : children) {
+            total += child->cost();
+        }
+        return total;
+    }
+};
+
+// Nodo del arbol sintactico de una consulta
+struct QueryNode {
+    enum Kind { TERM, PHRASE, AND, OR, NOT };
+
+    Kind kind;
+    std::string term;   // Palabra o, en PHRASE, el texto entre comillas
+    uint32_t slop = 0;  // Solo PHRASE: palabras de mas permitidas (~N)
+    std::vector<std::unique_ptr<QueryNode>> children;
+
+    explicit QueryNode(Kind node_kind, std::string text = "") : kind(node_kind), term(std::move(text)) {}
+};
+
+// Analizador descendente recursivo. Precedencia: NOT > AND > OR.
+class QueryParser {
+private:
+    std::vector<std::string> tokens;
+    size_t pos = 0;
+
+    static bool is_operator(const std::string& token) {
+        return token == "AND" || token == "OR" || token == "NOT";
+    }
+
+    bool at(const char* token) const {
+        return pos < tokens.size() && tokens[pos] == token;
+    }
+
+    std::unique_ptr<QueryNode> parse_or() {
+        auto left = parse_and();
+        if (!at("OR")) return left;
+        auto node = std::make_unique<QueryNode>(QueryNode::OR);
+        node->children.push_back(std::move(left));
+        while (at("OR")) {
+            pos++;
+            node->children.push_back(parse_and());
+        }
+        return node;
+    }
+
+    std::unique_ptr<QueryNode> parse_and() {
+        auto left = parse_unary();
+        auto node = std::make_unique<QueryNode>(QueryNode::AND);
+        node->children.push_back(std::move(left));
+        while (pos < tokens.size() && !at("OR") && !at(")")) {
+            if (at("AND")) pos++;
+            node->children.push_back(parse_unary());
+        }
+        if (node->children.size() == 1) return std::move(node->children[0]);
+        return node;
+    }
+
+    std::unique_ptr<QueryNode> parse_unary() {
+        if (pos >= tokens.size()) {
+            throw std::runtime_error("Query syntax error: unexpected end of query");
+        }
+        const std::string& token = tokens[pos];
+        if (token == "NOT" || token == "-") {
+            pos++;
+            auto node = std::make_unique<QueryNode>(QueryNode::NOT);
+            node->children.push_back(parse_unary());
+            return node;
+        }
+        if (token == "(") {
+            pos++;
+            auto node = parse_or();
+            if (!at(")")) throw std::runtime_error("Query syntax error: missing ')'");
+            pos++;
+            return node;
+        }
+        if (token[0] == '"') {
+            // "texto" o "texto"~N; el analizador lexico garantiza la comilla de cierre
+            size_t close = token.rfind('"');
+            auto node = std::make_unique<QueryNode>(QueryNode::PHRASE, token.substr(1, close - 1));
+            if (close + 1 < token.size()) {
+                std::string digits = token.substr(close + 2);
+                if (digits.empty()) throw std::runtime_error("Query syntax error: expected a number after '~'");
+                node->slop = static_cast<uint32_t>(std::stoul(digits));
+            }
+            pos++;
+            return node;
+        }
+        if (token == ")" || is_operator(token)) {
+            throw std::runtime_error("Query syntax error: unexpected '" + token + "'");
+        }
+        pos++;
+        return std::make_unique<QueryNode>(QueryNode::TERM, token);
+    }
+
+public:
+    // Separa la consulta en palabras, parentesis, "-" delante de una palabra y
+    // frases entre comillas (con su ~N detras, si lo hay)
+    explicit QueryParser(std::string_view query) {
+        std::string word;
+        auto flush = [&]() {
+            if (!word.empty()) tokens.push_back(std::move(word));
+            word.clear();
+        };
+        for (size_t i = 0; i < query.size(); ++i) {
+            char c = query[i];
+            if (c == '"' && word.empty()) {
+                size_t close = query.find('"', i + 1);
+                if (close == std::string_view::npos) {
+                    throw std::runtime_error("Query syntax error: missing closing '\"'");
+                }
+                size_t stop = close + 1;
+                if (stop < query.size() && query[stop] == '~') {
+                    stop++;
+                    while (stop < query.size() && std::isdigit(static_cast<unsigned char>(query[stop]))) stop++;
+                }
+                tokens.emplace_back(query.substr(i, stop - i));
+                i = stop - 1;
+            } else if (std::isspace(static_cast<unsigned char>(c))) {
+                flush();
+            } else if (c == '(' || c == ')') {
+                flush();
+                tokens.emplace_back(1, c);
+            } else if (c == '-' && word.empty()) {
+                tokens.emplace_back("-");
+            } else {
+                word.push_back(c);
+            }
+        }
+        flush();
+    }
+
+    std::unique_ptr<QueryNode> parse() {
+        if (tokens.empty()) throw std::runtime_error("Query syntax error: empty query");
+        auto root = parse_or();
+        if (pos < tokens.size()) {
+            throw std::runtime_error("Query syntax error: unexpected '" + tokens[pos] + "'");
+        }
+        return root;
+    }
+};
+
+struct ScoredDoc {
+    uint32_t doc;
+    double score;
+};
+
+struct RankedResults {
+    std::vector<ScoredDoc> docs;  // De mayor a menor puntuacion
+    uint64_t scored = 0;          // Documentos que se llegaron a puntuar
+};
+
+// Abre un segmento (mapeado en memoria; el diccionario se consulta con busqueda
+// binaria sobre sus bloques) o un indice incremental con varios segmentos y
+// evalua consultas booleanas o de ranking sobre el. Con varios segmentos cada uno
+// se evalua por separado y los ids globales de documento son la base del
+// segmento mas su id local; los documentos con tombstone no se devuelven.
+class QueryEngine {
+private:
+    struct Part {
+        std::string name;
+        std::unique_ptr<SegmentReader> segment;
+        DocumentTable documents;
+        std::vector<bool> deleted;  // Vacio si el segmento no tiene borrados
+        uint32_t base = 0;          // Id global de su primer documento
+    };
+
+    std::vector<std::unique_ptr<Part>> parts;
+    Tokenizer tokenizer;
+    // Longitudes por id global copiadas de las tablas de documentos para leerlas sin su mutex
+    std::vector<uint32_t> doc_lengths;
+    uint64_t live_docs = 0;
+    double average_length = 1;
+    uint32_t min_length = 0;
+    double k1 = 1.2;
+    double b = 0.75;
+
+    static bool is_deleted(const Part& part, uint32_t doc) {
+        return !part.deleted.empty() && part.deleted[doc];
+    }
+
+    // Parte de BM25 que depende del documento; el total es idf * term_score
+    double term_score(uint32_t freq, uint32_t length) const {
+        double norm = k1 * (1.0 - b + b * static_cast<double>(length) / average_length);
+        return freq * (k1 + 1.0) / (freq + norm);
+    }
+
+    // Palabras distintas de la consulta fuera de los NOT, en orden de aparicion
+    void collect_terms(const QueryNode& node, std::vector<std::string>& terms) {
+        if (node.kind == QueryNode::NOT) return;
+        if (node.kind == QueryNode::TERM || node.kind == QueryNode::PHRASE) {
+            for (const auto& term : split_words(node.term)) {
+                if (std::find(terms.begin(), terms.end(), term) == terms.end()) {
+                    terms.push_back(term);
+                }
+            }
+            return;
+        }
+        for (const auto& child : node.children) {
+            collect_terms(*child, terms);
+        }
+    }
+
+    // Condiciones del nivel superior de la consulta (hijos de los AND, sin el AND)
+    static void collect_clauses(const QueryNode& node, std::vector<const QueryNode*>& clauses) {
+        if (node.kind != QueryNode::AND) {
+            clauses.push_back(&node);
+            return;
+        }
+        for (const auto& child : node.children) {
+            collect_clauses(*child, clauses);
+        }
+    }
+
+    // NOT o frase de varias palabras en cualquier punto de node
+    bool has_constraint(const QueryNode& node) {
+        if (node.kind == QueryNode::NOT) return true;
+        if (node.kind == QueryNode::PHRASE) return split_words(node.term).size() > 1;
+        for (const auto& child : node.children) {
+            if (has_constraint(*child)) return true;
+        }
+        return false;
+    }
+
+    // En el ranking las palabras puntuan como en un OR, pero los NOT y las frases
+    // siguen siendo condiciones: un documento solo se puntua si contiene todas las
+    // frases y nada de lo excluido. Devuelve null si la consulta no tiene ninguna.
+    std::unique_ptr<DocIterator> rank_filter(const SegmentReader& segment,
+                                             const std::vector<const QueryNode*>& clauses) {
+        std::vector<std::unique_ptr<DocIterator>> include;
+        std::vector<std::unique_ptr<DocIterator>> exclude;
+        for (const QueryNode* clause : clauses) {
+            if (clause->kind == QueryNode::NOT) {
+                exclude.push_back(build(segment, *clause->children[0]));
+            } else if (has_constraint(*clause)) {
+                include.push_back(build(segment, *clause));
+            }
+        }
+        if (include.empty() && exclude.empty()) return nullptr;
+        if (include.empty()) include.push_back(all_docs(segment));
+        return std::make_unique<AndIterator>(std::move(include), std::move(exclude));
+    }
+
+    // Normaliza una palabra de la consulta igual que al indexar
+    std::string normalize(const std::string& word) {
+        std::string result;
+        tokenizer.tokenize(word, [&](std::string_view token) {
+            if (result.empty()) result.assign(token.data(), token.size());
+        });
+        return result;
+    }
+
+    // Palabras de una frase tal como se indexaron
+    std::vector<std::string> split_words(const std::string& text) {
+        std::vector<std::string> result;
+        tokenizer.tokenize(text, [&](std::string_view token) {
+            result.emplace_back(token);
+        });
+        return result;
+    }
+
+    static std::unique_ptr<DocIterator> all_docs(const SegmentReader& segment) {
+        return std::make_unique<AllDocsIterator>(static_cast<uint32_t>(segment.get_header().num_docs));
+    }
+
+    std::unique_ptr<DocIterator> build(const SegmentReader& segment, const QueryNode& node) {
+        switch (node.kind) {
+        case QueryNode::TERM: {
+            TermEntry entry;
+            std::string term = normalize(node.term);
+            if (!term.empty() && segment.find(term, entry)) {
+                return std::make_unique<TermIterator>(segment.cursor(entry));
+            }
+            return std::make_unique<TermIterator>(PostingCursor());
+        }
+        case QueryNode::PHRASE: {
+            std::vector<std::string> words = split_words(node.term);
+            std::vector<PostingCursor> cursors;
+            TermEntry entry;
+            if (words.size() > 1 && !segment.has_positions()) {
+                throw std::runtime_error("Phrase queries need an index built with --positions");
+            }
+            for (const auto& word : words) {
+                if (!segment.find(word, entry)) return std::make_unique<TermIterator>(PostingCursor());
+                cursors.push_back(segment.cursor(entry, words.size() > 1));
+            }
+            if (cursors.empty()) return std::make_unique<TermIterator>(PostingCursor());
+            if (cursors.size() == 1) return std::make_unique<TermIterator>(cursors[0]);
+            return std::make_unique<PhraseIterator>(std::move(cursors), node.slop);
+        }
+        case QueryNode::AND: {
+            std::vector<std::unique_ptr<DocIterator>> include;
+            std::vector<std::unique_ptr<DocIterator>> exclude;
+            for (const auto& child : node.children) {
+                if (child->kind == QueryNode::NOT) {
+                    exclude.push_back(build(segment, *child->children[0]));
+                } else {
+                    include.push_back(build(segment, *child));
+                }
+            }
+            if (include.empty()) include.push_back(all_docs(segment));
+            return std::make_unique<AndIterator>(std::move(include), std::move(exclude));
+        }
+        case QueryNode::OR: {
+            std::vector<std::unique_ptr<DocIterator>> options;
+            for (const auto& child : node.children) {
+                options.push_back(build(segment, *child));
+            }
+            return std::make_unique<OrIterator>(std::move(options));
+        }
+        case QueryNode::NOT: {
+            std::vector<std::unique_ptr<DocIterator>> include;
+            std::vector<std::unique_ptr<DocIterator>> exclude;
+            include.push_back(all_docs(segment));
+            exclude.push_back(build(segment, *node.children[0]));
+            return std::make_unique<AndIterator>(std::move(include), std::move(exclude));
+        }
+        }
+        throw std::logic_error("Unknown query node");
+    }
+
+    void add_part(const std::string& name, const std::string& path, const IndexManifest* manifest) {
+        auto part = std::make_unique<Part>();
+        part->name = name;
+        part->segment = std::make_unique<SegmentReader>(path);
+        part->segment->load_documents(part->documents);
+        if (manifest) {
+            part->deleted = deleted_documents(*manifest, name, part->documents);
+            if (std::find(part->deleted.begin(), part->deleted.end(), true) == part->deleted.end()) {
+                part->deleted.clear();
+            }
+        }
+        part->base = static_cast<uint32_t>(doc_lengths.size());
+        for (uint32_t doc = 0; doc < part->documents.size(); ++doc) {
+            doc_lengths.push_back(part->documents.length(doc));
+        }
+        parts.push_back(std::move(part));
+    }
+
+    // Documentos vivos que contienen word. N y la longitud media solo cuentan los
+    // vivos, asi que los postings con tombstone tampoco cuentan aqui: el idf es el
+    // mismo que daria reconstruir el indice sin ellos.
+    uint64_t document_frequency(const std::string& word) const {
+        uint64_t df = 0;
+        TermEntry entry;
+        for (const auto& part : parts) {
+            if (!part->segment->find(word, entry)) continue;
+            df += entry.doc_count;
+            if (part->deleted.empty()) continue;
+            PostingCursor cursor = part->segment->cursor(entry);
+            for (uint32_t doc = cursor.doc(); doc != PostingCursor::END; cursor.next(), doc = cursor.doc()) {
+                if (part->deleted[doc]) df--;
+            }
+        }
+        return df;
+    }
+
+    const Part& part_of(uint32_t doc) const {
+        auto it = std::upper_bound(parts.begin(), parts.end(), doc,
+                                   [](uint32_t id, const auto& part) { return id < part->base; });
+        return **(it - 1);
+    }
+
+public:
+    // path es un segmento o el directorio de un indice incremental (con MANIFEST)
+    QueryEngine(const std::string& path, unsigned normalize_mode) : tokenizer(normalize_mode) {
+        if (IndexManifest::is_index_directory(path)) {
+            IndexManifest manifest(path);
+            for (const auto& segment : manifest.segments()) {
+                add_part(segment.name, manifest.segment_path(segment.name), &manifest);
+            }
+        } else {
+            add_part(path, path, nullptr);
+        }
+
+        // Estadisticas de BM25 sobre los documentos vivos de todos los segmentos
+        uint64_t total_length = 0;
+        min_length = UINT32_MAX;
+        for (const auto& part : parts) {
+            for (uint32_t doc = 0; doc < part->documents.size(); ++doc) {
+                if (is_deleted(*part, doc)) continue;
+                uint32_t length = doc_lengths[part->base + doc];
+                total_length += length;
+                min_length = std::min(min_length, length);
+                live_docs++;
+            }
+        }
+        if (live_docs > 0) {
+            average_length = std::max(1.0, static_cast<double>(total_length) / live_docs);
+        } else {
+            min_length = 0;
+        }
+    }
+
+    void set_bm25(double k1_param, double b_param) {
+        k1 = k1_param;
+        b = b_param;
+    }
+
+    // Los k documentos con mayor puntuacion BM25 para las palabras de la consulta.
+    // Con varios segmentos el idf usa los documentos vivos de todos ellos y el
+    // top-k se comparte, asi que el umbral de WAND ya sube desde el primero.
+    RankedResults rank(std::string_view query, size_t k) {
+        for (const auto& part : parts) {
+            uint32_t version = part->segment->get_header().version;
+            if (version < 3) {
+                throw std::runtime_error("Segment version " + std::to_string(version) +
+                                         " has no term frequencies; rebuild the index to rank");
+            }
+        }
+        auto tree = QueryParser(query).parse();
+        std::vector<std::string> words;
+        collect_terms(*tree, words);
+
+        // Un NOT o una frase dentro de un OR no se puede aplicar como filtro
+        std::vector<const QueryNode*> clauses;
+        collect_clauses(*tree, clauses);
+        for (const QueryNode* clause : clauses) {
+            if (clause->kind != QueryNode::NOT && clause->kind != QueryNode::PHRASE && has_constraint(*clause)) {
+                throw std::runtime_error("Ranked queries only support NOT and phrases outside OR");
+            }
+        }
+
+        RankedResults results;
+        if (k == 0) return results;
+
+        // Frecuencia de documento de cada palabra en todo el indice
+        std::vector<double> idfs;
+        double num_docs = static_cast<double>(live_docs);
+        for (const auto& word : words) {
+            double count = static_cast<double>(document_frequency(word));
+            idfs.push_back(std::log(1.0 + std::max(0.0, num_docs - count + 0.5) / (count + 0.5)));
+        }
+
+        auto worse = [](const ScoredDoc& a, const ScoredDoc& c) {
+            return a.score != c.score ? a.score > c.score : a.doc < c.doc;
+        };
+        // Min-heap con el top-k actual; su cima es el umbral para entrar
+        std::priority_queue<ScoredDoc, std::vector<ScoredDoc>, decltype(worse)> top(worse);
+
+        struct WandTerm {
+            PostingCursor cursor;
+            double idf;
+            double upper;  // Cota de idf * term_score en cualquier documento
+        };
+        for (const auto& part : parts) {
+            std::unique_ptr<DocIterator> filter = rank_filter(*part->segment, clauses);
+            std::vector<WandTerm> terms;
+            for (size_t w = 0; w < words.size(); ++w) {
+                TermEntry entry;
+                if (!part->segment->find(words[w], entry) || entry.doc_count == 0) continue;
+                terms.push_back({part->segment->cursor(entry), idfs[w],
+                                 idfs[w] * term_score(entry.max_freq, min_length)});
+            }
+
+            std::vector<size_t> order(terms.size());
+            for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+
+            while (true) {
+                std::sort(order.begin(), order.end(), [&](size_t x, size_t y) {
+                    return terms[x].cursor.doc() < terms[y].cursor.doc();
+                });
+                double threshold = top.size() < k ? 0.0 : top.top().score;
+
+                // Pivote: primer termino en orden de documento con el que la suma de
+                // cotas supera el umbral; ningun documento anterior puede entrar
+                double bound = 0;
+                size_t pivot = order.size();
+                for (size_t i = 0; i < order.size(); ++i) {
+                    if (terms[order[i]].cursor.doc() == PostingCursor::END) break;
+                    bound += terms[order[i]].upper;
+                    if (bound > threshold) {
+                        pivot = i;
+                        break;
+                    }
+                }
+                if (pivot == order.size()) break;
+
+                uint32_t pivot_doc = terms[order[pivot]].cursor.doc();
+                if (terms[order[0]].cursor.doc() == pivot_doc) {
+                    // Los pivotes crecen, asi que el filtro solo avanza
+                    bool skip = is_deleted(*part, pivot_doc);
+                    if (!skip && filter) {
+                        filter->advance(pivot_doc);
+                        skip = filter->doc() != pivot_doc;
+                    }
+                    double score = 0;
+                    uint32_t doc = part->base + pivot_doc;
+                    for (size_t i : order) {
+                        if (terms[i].cursor.doc() != pivot_doc) break;
+                        if (!skip) score += terms[i].idf * term_score(terms[i].cursor.freq(), doc_lengths[doc]);
+                        terms[i].cursor.next();
+                    }
+                    if (skip) continue;
+                    results.scored++;
+                    if (top.size() < k) {
+                        top.push({doc, score});
+                    } else if (score > top.top().score) {
+                        top.pop();
+                        top.push({doc, score});
+                    }
+                } else {
+                    for (size_t i = 0; i < pivot; ++i) {
+                        terms[order[i]].cursor.advance(pivot_doc);
+                    }
+                }
+            }
+        }
+
+        while (!top.empty()) {
+            results.docs.push_back(top.top());
+            top.pop();
+        }
+        std::reverse(results.docs.begin(), results.docs.end());
+        return results;
+    }
+
+    // Ids globales de los documentos que cumplen la consulta, en orden creciente
+    std::vector<uint32_t> evaluate(std::string_view query) {
+        auto tree = QueryParser(query).parse();
+        std::vector<uint32_t> result;
+        for (const auto& part : parts) {
+            auto root = build(*part->segment, *tree);
+            for (uint32_t doc = root->doc(); doc != DocIterator::END; root->next(), doc = root->doc()) {
+                if (!is_deleted(*part, doc)) result.push_back(part->base + doc);
+            }
+        }
+        return result;
+    }
+
+    // Nombre del documento con id global doc
+    std::string name(uint32_t doc) const {
+        const Part& part = part_of(doc);
+        return part.documents.name(doc - part.base);
+    }
+
+    size_t num_segments() const {
+        return parts.size();
+    }
+
+    // Terminos del diccionario de cada segmento (un termino en varios cuenta varias veces)
+    size_t num_terms() const {
+        size_t terms = 0;
+        for (const auto& part : parts) {
+            terms += part->segment->num_terms();
+        }
+        return terms;
+    }
+
+    // Documentos sin tombstone
+    uint64_t num_documents() const {
+        return live_docs;
+    }
+};